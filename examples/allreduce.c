@@ -0,0 +1,87 @@
+/*
+The purpose of this example is to test allreduce with both algorithms, on
+vectors of bytes and of doubles, and to check that every rank gets exactly
+the same result, even for sums of doubles that depend on the order.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define SMALL 1000
+#define LARGE (300 * 1000 + 7)
+
+static void check_bytes(int count, int world_rank, int world_size) {
+    unsigned char *data = malloc(count);
+    unsigned char *result = malloc(count);
+    assert(data && result);
+
+    for (int i = 0; i < count; ++i) {
+        data[i] = (unsigned char) (i * 7 + world_rank);
+    }
+    ASSERT_MIMPI_OK(MIMPI_Allreduce(data, result, count, MIMPI_SUM));
+    for (int i = 0; i < count; ++i) {
+        assert(result[i] == (unsigned char) (i * 7 * world_size +
+            world_size * (world_size - 1) / 2));
+    }
+
+    ASSERT_MIMPI_OK(MIMPI_Allreduce(data, result, count, MIMPI_MIN));
+    for (int i = 0; i < count; ++i) {
+        unsigned char expected = 255;
+        for (int r = 0; r < world_size; ++r) {
+            unsigned char value = (unsigned char) (i * 7 + r);
+            expected = (value < expected) ? value : expected;
+        }
+        assert(result[i] == expected);
+    }
+
+    free(data);
+    free(result);
+}
+
+static void check_doubles(int count, int world_rank) {
+    double *data = malloc(count * sizeof(double));
+    double *result = malloc(count * sizeof(double));
+    unsigned char *highest = malloc(count * sizeof(double));
+    unsigned char *lowest = malloc(count * sizeof(double));
+    assert(data && result && highest && lowest);
+
+    for (int i = 0; i < count; ++i) {
+        data[i] = 1.0 / (world_rank + 3) + i * 1e-7;
+    }
+    ASSERT_MIMPI_OK(MIMPI_Allreduce_typed(data, result, count, MIMPI_DOUBLE,
+        MIMPI_SUM));
+
+    // The bytes of the result are equal everywhere iff max == min.
+    int const bytes = count * sizeof(double);
+    ASSERT_MIMPI_OK(MIMPI_Allreduce(result, highest, bytes, MIMPI_MAX));
+    ASSERT_MIMPI_OK(MIMPI_Allreduce(result, lowest, bytes, MIMPI_MIN));
+    assert(memcmp(highest, lowest, bytes) == 0);
+    assert(memcmp(highest, result, bytes) == 0);
+
+    free(data);
+    free(result);
+    free(highest);
+    free(lowest);
+}
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    check_bytes(0, world_rank, world_size);
+    check_bytes(1, world_rank, world_size);
+    check_bytes(SMALL, world_rank, world_size);
+    check_bytes(LARGE, world_rank, world_size);
+    check_doubles(SMALL, world_rank);
+    check_doubles(LARGE / 8, world_rank);
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+The purpose of this example is to test all-to-all exchanges with blocks of
+equal and of various sizes, some of them empty, in worlds of any size.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+static unsigned char value(int from, int to, int i) {
+    return (unsigned char) (from * 37 + to * 13 + i * 11 + 1);
+}
+
+/* Size of the block from one rank to another in the variable case. */
+static int length(int from, int to, int count) {
+    return ((from + to) % 3 == 2) ? 0 : count + from * 7 + to * 101;
+}
+
+static void check(int count, int world_rank, int world_size) {
+    int *send_counts = malloc(world_size * sizeof(int));
+    int *send_displs = malloc(world_size * sizeof(int));
+    int *recv_counts = malloc(world_size * sizeof(int));
+    int *recv_displs = malloc(world_size * sizeof(int));
+    assert(send_counts && send_displs && recv_counts && recv_displs);
+
+    int sent = 0;
+    int received = 0;
+    for (int r = 0; r < world_size; ++r) {
+        send_counts[r] = length(world_rank, r, count);
+        send_displs[r] = sent;
+        sent += send_counts[r];
+        // Received blocks go in reverse order of ranks.
+        int q = world_size - 1 - r;
+        recv_counts[q] = length(q, world_rank, count);
+        recv_displs[q] = received;
+        received += recv_counts[q];
+    }
+
+    int size = (sent > count * world_size) ? sent : count * world_size;
+    unsigned char *out = malloc(size + 1);
+    unsigned char *in = malloc(
+        ((received > count * world_size) ? received : count * world_size) + 1);
+    assert(out && in);
+
+    for (int r = 0; r < world_size; ++r) {
+        for (int i = 0; i < count; ++i) {
+            out[r * count + i] = value(world_rank, r, i);
+        }
+    }
+    ASSERT_MIMPI_OK(MIMPI_Alltoall(out, in, count));
+    for (int r = 0; r < world_size; ++r) {
+        for (int i = 0; i < count; ++i) {
+            assert(in[r * count + i] == value(r, world_rank, i));
+        }
+    }
+
+    for (int r = 0; r < world_size; ++r) {
+        for (int i = 0; i < send_counts[r]; ++i) {
+            out[send_displs[r] + i] = value(world_rank, r, i);
+        }
+    }
+    ASSERT_MIMPI_OK(MIMPI_Alltoallv(out, send_counts, send_displs,
+        in, recv_counts, recv_displs));
+    for (int r = 0; r < world_size; ++r) {
+        for (int i = 0; i < recv_counts[r]; ++i) {
+            assert(in[recv_displs[r] + i] == value(r, world_rank, i));
+        }
+    }
+
+    free(out);
+    free(in);
+    free(send_counts);
+    free(send_displs);
+    free(recv_counts);
+    free(recv_displs);
+}
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    check(0, world_rank, world_size);
+    check(1, world_rank, world_size);
+    check(1000, world_rank, world_size);
+    check(100 * 1000 + 3, world_rank, world_size);
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,26 @@
+/*
+The purpose of this example is to test that a barrier fails on every rank
+once one of them has left the MPI block without entering it.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+
+    if (world_rank != world_size / 2) {
+        assert(MIMPI_Barrier() == MIMPI_ERROR_REMOTE_FINISHED);
+    }
+
+    MIMPI_Finalize();
+    return 0;
+}
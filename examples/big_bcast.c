@@ -0,0 +1,36 @@
+/*
+The purpose of this example is to test broadcasts of messages spanning many
+segments, including a partial last one, from every root in turn.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define SIZE (1000 * 1000 + 17)
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    unsigned char *data = malloc(SIZE);
+    assert(data);
+
+    for (int root = 0; root < world_size; ++root) {
+        for (int i = 0; i < SIZE; ++i) {
+            data[i] = (world_rank == root) ? (unsigned char) (i * 31 + root) : 0;
+        }
+        ASSERT_MIMPI_OK(MIMPI_Bcast(data, SIZE, root));
+        for (int i = 0; i < SIZE; ++i) {
+            assert(data[i] == (unsigned char) (i * 31 + root));
+        }
+    }
+
+    free(data);
+    MIMPI_Finalize();
+    return 0;
+}
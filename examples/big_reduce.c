@@ -0,0 +1,55 @@
+/*
+The purpose of this example is to test reductions of vectors spanning many
+segments, including a partial last one, to every root in turn.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define SIZE (1000 * 1000 + 17)
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    unsigned char *data = malloc(SIZE);
+    unsigned char *result = malloc(SIZE);
+    assert(data && result);
+
+    for (int i = 0; i < SIZE; ++i) {
+        data[i] = (unsigned char) (i * 31 + world_rank);
+    }
+
+    for (int root = 0; root < world_size; ++root) {
+        ASSERT_MIMPI_OK(MIMPI_Reduce(data, result, SIZE, MIMPI_SUM, root));
+        if (world_rank == root) {
+            for (int i = 0; i < SIZE; ++i) {
+                unsigned char expected = (unsigned char) (i * 31 * world_size +
+                    world_size * (world_size - 1) / 2);
+                assert(result[i] == expected);
+            }
+        }
+
+        ASSERT_MIMPI_OK(MIMPI_Reduce(data, result, SIZE, MIMPI_MAX, root));
+        if (world_rank == root) {
+            for (int i = 0; i < SIZE; ++i) {
+                unsigned char expected = 0;
+                for (int r = 0; r < world_size; ++r) {
+                    unsigned char value = (unsigned char) (i * 31 + r);
+                    expected = (value > expected) ? value : expected;
+                }
+                assert(result[i] == expected);
+            }
+        }
+    }
+
+    free(data);
+    free(result);
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+The purpose of this example is to test that contexts of freed communicators
+are used again: far more duplicates are created and freed than there are
+contexts, and a communicator split off after only some ranks freed theirs
+still gets a context none of its members uses.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define CYCLES 70000
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    for (int i = 0; i < CYCLES; ++i) {
+        MIMPI_Comm copy;
+        ASSERT_MIMPI_OK(MIMPI_Comm_dup(MIMPI_COMM_WORLD, &copy));
+        if (i % 10000 == 0) {
+            ASSERT_MIMPI_OK(MIMPI_Barrier_comm(copy));
+        }
+        MIMPI_Comm_free(&copy);
+    }
+
+    // Even ranks free the first of two duplicates, odd ones keep it.
+    MIMPI_Comm first;
+    MIMPI_Comm second;
+    ASSERT_MIMPI_OK(MIMPI_Comm_dup(MIMPI_COMM_WORLD, &first));
+    ASSERT_MIMPI_OK(MIMPI_Comm_dup(MIMPI_COMM_WORLD, &second));
+    if (world_rank % 2 == 0) {
+        MIMPI_Comm_free(&first);
+    }
+    MIMPI_Comm third;
+    ASSERT_MIMPI_OK(MIMPI_Comm_dup(MIMPI_COMM_WORLD, &third));
+
+    // Messages of the new communicator match none of the others.
+    if (world_size > 1 && world_rank < 2) {
+        int const peer = 1 - world_rank;
+        int values[3] = {1, 2, 3};
+        if (world_rank == 0) {
+            ASSERT_MIMPI_OK(MIMPI_Send_comm(&values[1], sizeof(int), peer, 4,
+                second));
+            ASSERT_MIMPI_OK(MIMPI_Send_comm(&values[2], sizeof(int), peer, 4,
+                third));
+        }
+        else {
+            int value = 0;
+            ASSERT_MIMPI_OK(MIMPI_Recv_comm(&value, sizeof(int), peer, 4,
+                third));
+            assert(value == 3);
+            ASSERT_MIMPI_OK(MIMPI_Recv_comm(&value, sizeof(int), peer, 4,
+                second));
+            assert(value == 2);
+        }
+    }
+    ASSERT_MIMPI_OK(MIMPI_Barrier_comm(third));
+
+    MIMPI_Comm_free(&first);
+    MIMPI_Comm_free(&second);
+    MIMPI_Comm_free(&third);
+
+    MIMPI_Finalize();
+    return 0;
+}
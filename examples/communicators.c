@@ -0,0 +1,231 @@
+/*
+The purpose of this example is to test communicators: splitting the world
+into ranks of even and odd world rank (in reverse order), collectives run by
+both halves at once, messages (blocking or not) that only match receives in
+their own communicator, duplicates, nested splits and ranks that join no
+communicator.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define ROUNDS 20
+#define LARGE (1000 * 1000 + 3)
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    int const parity = world_rank % 2;
+
+    assert(MIMPI_Comm_rank(MIMPI_COMM_WORLD) == world_rank);
+    assert(MIMPI_Comm_size(MIMPI_COMM_WORLD) == world_size);
+
+    MIMPI_Comm half;
+    ASSERT_MIMPI_OK(MIMPI_Comm_split(MIMPI_COMM_WORLD, parity, -world_rank,
+        &half));
+    int const size = (world_size - parity + 1) / 2;
+    int const rank = size - 1 - world_rank / 2;
+    assert(MIMPI_Comm_size(half) == size);
+    assert(MIMPI_Comm_rank(half) == rank);
+
+    // Both halves run collectives of their own at the same time.
+    for (int i = 0; i < ROUNDS; ++i) {
+        ASSERT_MIMPI_OK(MIMPI_Barrier_comm(half));
+    }
+
+    int64_t mine = world_rank;
+    int64_t sum = 0;
+    ASSERT_MIMPI_OK(MIMPI_Allreduce_comm(&mine, &sum, 1, MIMPI_INT64,
+        MIMPI_SUM, half));
+    int64_t expected = 0;
+    for (int r = parity; r < world_size; r += 2) {
+        expected += r;
+    }
+    assert(sum == expected);
+
+    int *ranks = malloc(size * sizeof(int));
+    assert(ranks);
+    ASSERT_MIMPI_OK(MIMPI_Allgather_comm(&world_rank, ranks, sizeof(int),
+        half));
+    for (int r = 0; r < size; ++r) {
+        assert(ranks[r] == 2 * (size - 1 - r) + parity);
+    }
+    memset(ranks, 0, size * sizeof(int));
+    ASSERT_MIMPI_OK(MIMPI_Gather_comm(&world_rank, ranks, sizeof(int),
+        size - 1, half));
+    if (rank == size - 1) {
+        for (int r = 0; r < size; ++r) {
+            assert(ranks[r] == 2 * (size - 1 - r) + parity);
+        }
+    }
+    free(ranks);
+
+    unsigned char *data = malloc(LARGE);
+    assert(data);
+    if (rank == 0) {
+        memset(data, 42 + parity, LARGE);
+    }
+    ASSERT_MIMPI_OK(MIMPI_Bcast_comm(data, LARGE, 0, half));
+    for (int i = 0; i < LARGE; i += 4099) {
+        assert(data[i] == 42 + parity);
+    }
+    unsigned char small = 1;
+    unsigned char count = 0;
+    ASSERT_MIMPI_OK(MIMPI_Reduce_comm(&small, &count, 1, MIMPI_UINT8,
+        MIMPI_SUM, 0, half));
+    if (rank == 0) {
+        assert(count == size);
+    }
+
+    // Blocks of scatters and all-to-alls follow ranks in the half.
+    int *blocks = malloc(size * sizeof(int));
+    int *received = malloc(size * sizeof(int));
+    int *counts = malloc(size * sizeof(int));
+    int *displs = malloc(size * sizeof(int));
+    assert(blocks && received && counts && displs);
+    for (int r = 0; r < size; ++r) {
+        blocks[r] = 2 * (size - 1 - r) + parity;
+        counts[r] = sizeof(int);
+        displs[r] = (size - 1 - r) * sizeof(int);
+    }
+    int block = -1;
+    ASSERT_MIMPI_OK(MIMPI_Scatter_comm(blocks, &block, sizeof(int), size - 1,
+        half));
+    assert(block == world_rank);
+    // Displacements reversed, so everyone gets the block of its mirror.
+    ASSERT_MIMPI_OK(MIMPI_Scatterv_comm(blocks, counts, displs, &block, 0,
+        half));
+    assert(block == 2 * rank + parity);
+    for (int r = 0; r < size; ++r) {
+        blocks[r] = rank * size + r;
+        displs[r] = r * sizeof(int);
+    }
+    ASSERT_MIMPI_OK(MIMPI_Alltoall_comm(blocks, received, sizeof(int), half));
+    for (int r = 0; r < size; ++r) {
+        assert(received[r] == r * size + rank);
+    }
+    memset(received, 0, size * sizeof(int));
+    ASSERT_MIMPI_OK(MIMPI_Alltoallv_comm(blocks, counts, displs, received,
+        counts, displs, half));
+    for (int r = 0; r < size; ++r) {
+        assert(received[r] == r * size + rank);
+    }
+    assert(MIMPI_Scatter_comm(blocks, &block, sizeof(int), size, half) ==
+        MIMPI_ERROR_NO_SUCH_RANK);
+    free(blocks);
+    free(received);
+    free(counts);
+    free(displs);
+
+    // Non-blocking messages around the ring of the half.
+    if (size > 1) {
+        MIMPI_Request requests[2];
+        int token = -1;
+        ASSERT_MIMPI_OK(MIMPI_Irecv_comm(&token, sizeof(int),
+            (rank + size - 1) % size, 9, half, &requests[0]));
+        ASSERT_MIMPI_OK(MIMPI_Isend_comm(&rank, sizeof(int),
+            (rank + 1) % size, 9, half, &requests[1]));
+        ASSERT_MIMPI_OK(MIMPI_Waitall(2, requests));
+        assert(token == (rank + size - 1) % size);
+    }
+    MIMPI_Request request;
+    assert(MIMPI_Isend_comm(&small, 1, rank, 1, half, &request) ==
+        MIMPI_ERROR_ATTEMPTED_SELF_OP);
+    assert(MIMPI_Irecv_comm(&small, 1, -1, 1, half, &request) ==
+        MIMPI_ERROR_NO_SUCH_RANK);
+
+    // Messages with the same tag and peer go to their own communicators.
+    MIMPI_Comm copy;
+    ASSERT_MIMPI_OK(MIMPI_Comm_dup(half, &copy));
+    assert(MIMPI_Comm_rank(copy) == rank && MIMPI_Comm_size(copy) == size);
+    if (size > 1 && rank < 2) {
+        int const peer = 1 - rank;
+        int const peer_world = 2 * (size - 1 - peer) + parity;
+        if (rank == 0) {
+            int values[3] = {1, 2, 3};
+            ASSERT_MIMPI_OK(MIMPI_Send(&values[0], sizeof(int), peer_world, 7));
+            ASSERT_MIMPI_OK(MIMPI_Send_comm(&values[1], sizeof(int), peer, 7,
+                half));
+            ASSERT_MIMPI_OK(MIMPI_Send_comm(&values[2], sizeof(int), peer, 7,
+                copy));
+            ASSERT_MIMPI_OK(MIMPI_Send_comm(data, LARGE, peer, 8, copy));
+            ASSERT_MIMPI_OK(MIMPI_Send_comm(data, LARGE, peer, 8, half));
+        }
+        else {
+            int value = 0;
+            ASSERT_MIMPI_OK(MIMPI_Recv_comm(&value, sizeof(int), peer,
+                MIMPI_ANY_TAG, copy));
+            assert(value == 3);
+            ASSERT_MIMPI_OK(MIMPI_Recv_comm(&value, sizeof(int), peer, 7,
+                half));
+            assert(value == 2);
+            ASSERT_MIMPI_OK(MIMPI_Recv(&value, sizeof(int), peer_world, 7));
+            assert(value == 1);
+            ASSERT_MIMPI_OK(MIMPI_Recv_comm(data, LARGE, peer, 8, half));
+            ASSERT_MIMPI_OK(MIMPI_Recv_comm(data, LARGE, peer, 8, copy));
+        }
+    }
+    assert(MIMPI_Send_comm(&small, 1, rank, 1, half) ==
+        MIMPI_ERROR_ATTEMPTED_SELF_OP);
+    assert(MIMPI_Recv_comm(&small, 1, size, 1, half) ==
+        MIMPI_ERROR_NO_SUCH_RANK);
+    assert(MIMPI_Bcast_comm(&small, 1, size, half) ==
+        MIMPI_ERROR_NO_SUCH_RANK);
+    MIMPI_Comm_free(&copy);
+    assert(copy == MIMPI_COMM_NULL);
+
+    // A split of a split, which only the first two ranks of each half join.
+    MIMPI_Comm pair;
+    ASSERT_MIMPI_OK(MIMPI_Comm_split(half, rank < 2 ? 0 : MIMPI_UNDEFINED,
+        0, &pair));
+    if (rank < 2) {
+        assert(MIMPI_Comm_size(pair) == (size < 2 ? size : 2));
+        assert(MIMPI_Comm_rank(pair) == rank);
+        unsigned char ones = 1;
+        unsigned char total = 0;
+        ASSERT_MIMPI_OK(MIMPI_Allreduce_comm(&ones, &total, 1, MIMPI_UINT8,
+            MIMPI_SUM, pair));
+        assert(total == MIMPI_Comm_size(pair));
+        MIMPI_Comm_free(&pair);
+    }
+    else {
+        assert(pair == MIMPI_COMM_NULL);
+    }
+
+    // The handle of no communicator is rejected, not dereferenced.
+    MIMPI_Comm none = MIMPI_COMM_NULL;
+    assert(MIMPI_Comm_rank(none) == -1 && MIMPI_Comm_size(none) == -1);
+    assert(MIMPI_Send_comm(&small, 1, 0, 1, none) ==
+        MIMPI_ERROR_INVALID_ARGUMENT);
+    assert(MIMPI_Recv_comm(&small, 1, 0, 1, none) ==
+        MIMPI_ERROR_INVALID_ARGUMENT);
+    assert(MIMPI_Isend_comm(&small, 1, 0, 1, none, &request) ==
+        MIMPI_ERROR_INVALID_ARGUMENT);
+    assert(request == MIMPI_REQUEST_NULL);
+    assert(MIMPI_Barrier_comm(none) == MIMPI_ERROR_INVALID_ARGUMENT);
+    assert(MIMPI_Bcast_comm(&small, 1, 0, none) ==
+        MIMPI_ERROR_INVALID_ARGUMENT);
+    assert(MIMPI_Allreduce_comm(&small, &count, 1, MIMPI_UINT8, MIMPI_SUM,
+        none) == MIMPI_ERROR_INVALID_ARGUMENT);
+    assert(MIMPI_Alltoall_comm(&small, &count, 1, none) ==
+        MIMPI_ERROR_INVALID_ARGUMENT);
+    assert(MIMPI_Comm_dup(none, &copy) == MIMPI_ERROR_INVALID_ARGUMENT);
+    assert(copy == MIMPI_COMM_NULL);
+    MIMPI_Comm_free(&none);
+
+    // The world still works after all of that.
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+    MIMPI_Comm_free(&half);
+    free(data);
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,52 @@
+/*
+The purpose of this example is to test deadlock detection beyond a pair of
+processes: a cycle through all ranks (in MIMPI_Recv and in MIMPI_Wait),
+a chain of receives that is only slow and must not be reported, and messages
+exchanged normally after a detected deadlock.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(true);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    int const next = (world_rank + 1) % world_size;
+    int const prev = (world_rank + world_size - 1) % world_size;
+
+    // Every rank waits for the next one.
+    char number = 0;
+    assert(MIMPI_Recv(&number, 1, next, 1) == MIMPI_ERROR_DEADLOCK_DETECTED);
+
+    MIMPI_Request request;
+    ASSERT_MIMPI_OK(MIMPI_Irecv(&number, 1, next, 2, &request));
+    assert(MIMPI_Wait(&request) == MIMPI_ERROR_DEADLOCK_DETECTED);
+
+    // The same chain, but the last rank sends after a while.
+    if (world_rank == world_size - 1) {
+        usleep(100 * 1000);
+        number = 42;
+    }
+    else {
+        ASSERT_MIMPI_OK(MIMPI_Recv(&number, 1, next, 3));
+        assert(number == 42);
+    }
+    if (world_rank > 0) {
+        ASSERT_MIMPI_OK(MIMPI_Send(&number, 1, prev, 3));
+    }
+
+    // Messages sent after a deadlock arrive as usual.
+    int token = world_rank;
+    ASSERT_MIMPI_OK(MIMPI_Send(&token, sizeof(int), prev, 4));
+    ASSERT_MIMPI_OK(MIMPI_Recv(&token, sizeof(int), next, 4));
+    assert(token == next);
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+The purpose of this example is to measure what deadlock detection costs
+communication that never deadlocks. Pairs of ranks play ping-pong with small
+and with rendezvous-sized messages, and rank 0 prints the time of a round
+trip. Detection is on if the first argument is 1. The number of round trips
+is the second argument (10000 by default).
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define SMALL 8
+#define LARGE (128 * 1024)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Returns the time of a round trip in microseconds. */
+static double ping_pong(int rounds, int count, char *data) {
+    int const world_rank = MIMPI_World_rank();
+    int const partner = world_rank ^ 1;
+
+    if (partner >= MIMPI_World_size()) {
+        return 0;
+    }
+
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+    double start = now();
+    for (int i = 0; i < rounds; ++i) {
+        if (world_rank % 2 == 0) {
+            ASSERT_MIMPI_OK(MIMPI_Send(data, count, partner, 1));
+            ASSERT_MIMPI_OK(MIMPI_Recv(data, count, partner, 1));
+        }
+        else {
+            ASSERT_MIMPI_OK(MIMPI_Recv(data, count, partner, 1));
+            ASSERT_MIMPI_OK(MIMPI_Send(data, count, partner, 1));
+        }
+    }
+    return (now() - start) * 1e6 / rounds;
+}
+
+int main(int argc, char **argv)
+{
+    bool const detection = (argc > 1) && atoi(argv[1]) == 1;
+    int const rounds = (argc > 2) ? atoi(argv[2]) : 10000;
+    char *data = calloc(LARGE, 1);
+    assert(data);
+
+    MIMPI_Init(detection);
+    double small = ping_pong(rounds, SMALL, data);
+    double large = ping_pong(rounds / 10 + 1, LARGE, data);
+
+    if (MIMPI_World_rank() == 0) {
+        printf("detection %-3s %8.2f us per %d B round trip, "
+            "%8.2f us per %d B round trip\n", detection ? "on" : "off",
+            small, SMALL, large, LARGE);
+    }
+    MIMPI_Finalize();
+
+    free(data);
+    return 0;
+}
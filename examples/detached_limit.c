@@ -0,0 +1,52 @@
+/*
+The purpose of this example is to check that copies of sent messages nobody
+received yet stay within MIMPI_DETACHED_LIMIT. Rank 0 sends many messages
+above the eager threshold to rank 1, which takes its time to receive them,
+so sends past the limit must wait for their receive instead of piling up.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define BIG (256 * 1024)
+#define MESSAGES 16
+
+static char data[BIG];
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    char const *limit_var = getenv("MIMPI_DETACHED_LIMIT");
+    int const held = (limit_var != NULL) ? atoi(limit_var) / BIG : MESSAGES;
+
+    if (world_rank == 0) {
+        MIMPI_Pool_stats before;
+        MIMPI_Get_pool_stats(&before);
+        for (int i = 0; i < MESSAGES; ++i) {
+            memset(data, i, BIG);
+            ASSERT_MIMPI_OK(MIMPI_Send(data, BIG, 1, i));
+
+            // Copies in use, and a few writer jobs at most besides them.
+            MIMPI_Pool_stats stats;
+            MIMPI_Get_pool_stats(&stats);
+            assert(stats.in_use <= before.in_use + held + 4);
+        }
+    }
+    else if (world_rank == 1) {
+        usleep(100 * 1000);
+        for (int i = 0; i < MESSAGES; ++i) {
+            ASSERT_MIMPI_OK(MIMPI_Recv(data, BIG, 0, i));
+            assert(data[0] == i && data[BIG - 1] == i);
+        }
+    }
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,41 @@
+/*
+The purpose of this example is to test MIMPI_Finalize with sends nobody
+received: every rank sends messages above the eager threshold, some larger
+than a pipe buffer, to every other rank and leaves without receiving any.
+Their copies are flushed to peers that are finalizing at the same time.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define SIZES 3
+
+static int const sizes[SIZES] = {70000, 200 * 1000, 1000 * 1000};
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    char *data = malloc(sizes[SIZES - 1]);
+    assert(data);
+    memset(data, world_rank, sizes[SIZES - 1]);
+
+    for (int i = 0; i < SIZES; ++i) {
+        for (int peer = 0; peer < world_size; ++peer) {
+            if (peer != world_rank) {
+                ASSERT_MIMPI_OK(MIMPI_Send(data, sizes[i], peer, i + 1));
+            }
+        }
+    }
+
+    free(data);
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+The purpose of this example is to test flow control: a burst of messages
+nobody receives yet must not take more than the budget at the receiver,
+the rest backs off to rendezvous, the sender waits once even announcements
+would not fit and everything still arrives in order.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define MESSAGES 1000
+#define SIZE 1000
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    char const *peer_var = getenv("MIMPI_PEER_BUDGET");
+    char const *rank_var = getenv("MIMPI_RANK_BUDGET");
+    long long budget = peer_var ? atoll(peer_var) : 4 << 20;
+    long long const rank_budget = rank_var ? atoll(rank_var) : 64 << 20;
+    if (rank_budget / (world_size - 1) < budget) {
+        budget = rank_budget / (world_size - 1);
+    }
+    char buf[SIZE];
+
+    if (world_rank == 1) {
+        for (int i = 0; i < MESSAGES; ++i) {
+            memset(buf, i, SIZE);
+            ASSERT_MIMPI_OK(MIMPI_Send(buf, SIZE, 0, 5));
+        }
+
+        MIMPI_Flow_stats stats;
+        MIMPI_Get_flow_stats(&stats);
+        assert(stats.eager_sends + stats.stalled_sends == MESSAGES);
+        assert((stats.stalled_sends > 0) == (budget < MESSAGES * SIZE));
+    }
+
+    else if (world_rank == 0) {
+        // Lets rank 1 run out of budget before anything is received.
+        usleep(100 * 1000);
+        for (int i = 0; i < MESSAGES; ++i) {
+            ASSERT_MIMPI_OK(MIMPI_Recv(buf, SIZE, 1, 5));
+            assert(buf[0] == (char) i && buf[SIZE - 1] == (char) i);
+        }
+
+        // Buffered messages, and a few queue buckets and writer jobs.
+        MIMPI_Pool_stats stats;
+        MIMPI_Get_pool_stats(&stats);
+        assert(stats.peak_bytes <= budget + 4096);
+    }
+
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+The purpose of this example is to test gathers to every root in turn and
+allgathers with both algorithms, with blocks of various sizes.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+static unsigned char value(int rank, int i) {
+    return (unsigned char) (rank * 37 + i * 11 + 1);
+}
+
+static void check(int count, int world_rank, int world_size) {
+    unsigned char *data = malloc(count + 1);
+    unsigned char *all = malloc((size_t) count * world_size + 1);
+    assert(data && all);
+
+    for (int i = 0; i < count; ++i) {
+        data[i] = value(world_rank, i);
+    }
+
+    for (int root = 0; root < world_size; ++root) {
+        for (int i = 0; i < count * world_size; ++i) {
+            all[i] = 0;
+        }
+        ASSERT_MIMPI_OK(MIMPI_Gather(data, all, count, root));
+        if (world_rank == root) {
+            for (int r = 0; r < world_size; ++r) {
+                for (int i = 0; i < count; ++i) {
+                    assert(all[r * count + i] == value(r, i));
+                }
+            }
+        }
+    }
+
+    ASSERT_MIMPI_OK(MIMPI_Allgather(data, all, count));
+    for (int r = 0; r < world_size; ++r) {
+        for (int i = 0; i < count; ++i) {
+            assert(all[r * count + i] == value(r, i));
+        }
+    }
+
+    free(data);
+    free(all);
+}
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    check(0, world_rank, world_size);
+    check(1, world_rank, world_size);
+    check(1000, world_rank, world_size);
+    check(100 * 1000 + 3, world_rank, world_size);
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,53 @@
+/*
+The purpose of this example is to test whether the library works with
+world sizes well above 16, where every rank talks to every other one.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define DATA_LEN 300
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    int const tag = 5;
+
+    int const next = (world_rank + 1) % world_size;
+    int const prev = (world_rank + world_size - 1) % world_size;
+    int number = world_rank;
+    if (world_size > 1) {
+        ASSERT_MIMPI_OK(MIMPI_Send(&number, sizeof(number), next, tag));
+        ASSERT_MIMPI_OK(MIMPI_Recv(&number, sizeof(number), prev, tag));
+        assert(number == prev);
+    }
+
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+
+    uint8_t data[DATA_LEN];
+    int const root = world_size - 1;
+    memset(data, world_rank == root ? 42 : 0, DATA_LEN);
+    ASSERT_MIMPI_OK(MIMPI_Bcast(data, DATA_LEN, root));
+    for (int i = 0; i < DATA_LEN; ++i) {
+        assert(data[i] == 42);
+    }
+
+    uint8_t result[DATA_LEN];
+    memset(data, 1, DATA_LEN);
+    ASSERT_MIMPI_OK(MIMPI_Reduce(data, result, DATA_LEN, MIMPI_SUM, root));
+    if (world_rank == root) {
+        for (int i = 0; i < DATA_LEN; ++i) {
+            assert(result[i] == (uint8_t) world_size);
+        }
+    }
+
+    MIMPI_Finalize();
+    return 0;
+}
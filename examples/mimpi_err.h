@@ -7,7 +7,7 @@
 
 static char const *const print_mimpi_error(MIMPI_Retcode const ret) {
     // This corresponds to MIMPI_Retcode enum values.
-    char const *const retcodename[] = {"SUCCESS", "ERROR_ATTEMPTED_SELF_OP", "ERROR_NO_SUCH_RANK", "ERROR_REMOTE_FINISHED", "ERROR_DEADLOCK_DETECTED"};
+    char const *const retcodename[] = {"SUCCESS", "ERROR_ATTEMPTED_SELF_OP", "ERROR_NO_SUCH_RANK", "ERROR_REMOTE_FINISHED", "ERROR_DEADLOCK_DETECTED", "ERROR_INVALID_ARGUMENT"};
     if (ret >= 0 && ret < sizeof(retcodename) / sizeof(*retcodename)) {
         return retcodename[ret];
     } else {
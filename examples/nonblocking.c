@@ -0,0 +1,97 @@
+/*
+The purpose of this example is to test non-blocking point-to-point
+communication: a halo exchange with all receives posted up front,
+collecting messages in completion order and reporting a finished peer.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define HALO 1000
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    int const next = (world_rank + 1) % world_size;
+    int const prev = (world_rank + world_size - 1) % world_size;
+
+    // Halo exchange: both receives are posted before anything is sent.
+    static int left[HALO], right[HALO], mine[HALO];
+    for (int i = 0; i < HALO; ++i) {
+        mine[i] = world_rank * HALO + i;
+    }
+
+    MIMPI_Request requests[4];
+    ASSERT_MIMPI_OK(MIMPI_Irecv(left, sizeof(left), prev, 1, &requests[0]));
+    ASSERT_MIMPI_OK(MIMPI_Irecv(right, sizeof(right), next, 2, &requests[1]));
+    ASSERT_MIMPI_OK(MIMPI_Isend(mine, sizeof(mine), next, 1, &requests[2]));
+    ASSERT_MIMPI_OK(MIMPI_Isend(mine, sizeof(mine), prev, 2, &requests[3]));
+    ASSERT_MIMPI_OK(MIMPI_Waitall(4, requests));
+    for (int i = 0; i < 4; ++i) {
+        assert(requests[i] == MIMPI_REQUEST_NULL);
+    }
+    for (int i = 0; i < HALO; ++i) {
+        assert(left[i] == prev * HALO + i);
+        assert(right[i] == next * HALO + i);
+    }
+
+    // Everybody sends before receiving, which must not block even when
+    // there is no budget left for small messages.
+    ASSERT_MIMPI_OK(MIMPI_Isend(mine, sizeof(mine), next, 6, &requests[0]));
+    ASSERT_MIMPI_OK(MIMPI_Irecv(left, sizeof(left), prev, 6, &requests[1]));
+    ASSERT_MIMPI_OK(MIMPI_Waitall(2, requests));
+    for (int i = 0; i < HALO; ++i) {
+        assert(left[i] == prev * HALO + i);
+    }
+
+    // Nothing can match before the barrier, so the receive is still pending.
+    int number = -1;
+    MIMPI_Request pending;
+    bool flag;
+    ASSERT_MIMPI_OK(MIMPI_Irecv(&number, sizeof(number), prev, 3, &pending));
+    ASSERT_MIMPI_OK(MIMPI_Test(&pending, &flag));
+    assert(!flag && pending != MIMPI_REQUEST_NULL);
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+    ASSERT_MIMPI_OK(MIMPI_Send(&world_rank, sizeof(world_rank), next, 3));
+    ASSERT_MIMPI_OK(MIMPI_Wait(&pending));
+    assert(number == prev && pending == MIMPI_REQUEST_NULL);
+
+    // Rank 0 collects one message from everybody in whatever order they come.
+    if (world_rank == 0) {
+        MIMPI_Request *from = malloc(world_size * sizeof(MIMPI_Request));
+        int *values = malloc(world_size * sizeof(int));
+        from[0] = MIMPI_REQUEST_NULL;
+        for (int i = 1; i < world_size; ++i) {
+            ASSERT_MIMPI_OK(MIMPI_Irecv(&values[i], sizeof(int), i, 4, &from[i]));
+        }
+        for (int i = 1; i < world_size; ++i) {
+            int index;
+            ASSERT_MIMPI_OK(MIMPI_Waitany(world_size, from, &index));
+            assert(index > 0 && from[index] == MIMPI_REQUEST_NULL);
+            assert(values[index] == 10 * index);
+        }
+        int index;
+        ASSERT_MIMPI_OK(MIMPI_Waitany(world_size, from, &index));
+        assert(index == -1);
+        free(from);
+        free(values);
+    } else {
+        int value = 10 * world_rank;
+        ASSERT_MIMPI_OK(MIMPI_Send(&value, sizeof(value), 0, 4));
+
+        // Rank 0 never sends this one, it just leaves the MPI block.
+        MIMPI_Request never;
+        ASSERT_MIMPI_OK(MIMPI_Irecv(&number, sizeof(number), 0, 5, &never));
+        assert(MIMPI_Wait(&never) == MIMPI_ERROR_REMOTE_FINISHED);
+        assert(never == MIMPI_REQUEST_NULL);
+    }
+
+    MIMPI_Finalize();
+    return 0;
+}
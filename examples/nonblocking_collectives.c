@@ -0,0 +1,136 @@
+/*
+The purpose of this example is to test non-blocking collectives: several of
+them outstanding at once, overlapped with point-to-point traffic, polled with
+MIMPI_Test, mixed with blocking ones, and progressing through a rank that
+is busy and does not call into the library.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define LARGE (1000 * 1000 + 3)
+#define SLOW_RANK 1
+#define SLOW_MS 500
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void fill(unsigned char *data, int count, int seed) {
+    for (int i = 0; i < count; ++i) {
+        data[i] = (unsigned char) (i * 13 + seed);
+    }
+}
+
+static bool filled(unsigned char const *data, int count, int seed) {
+    for (int i = 0; i < count; ++i) {
+        if (data[i] != (unsigned char) (i * 13 + seed)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    int const root = world_size - 1;
+    int const next = (world_rank + 1) % world_size;
+    int const prev = (world_rank + world_size - 1) % world_size;
+
+    unsigned char *data = malloc(LARGE);
+    unsigned char *sum = malloc(LARGE);
+    assert(data && sum);
+
+    // Three collectives at once, overlapped with a ring of sends.
+    if (world_rank == root) {
+        fill(data, LARGE, 7);
+    }
+    unsigned char mine = (unsigned char) world_rank;
+    unsigned char reduced = 0;
+    MIMPI_Request requests[3];
+    ASSERT_MIMPI_OK(MIMPI_Ibcast(data, LARGE, root, &requests[0]));
+    ASSERT_MIMPI_OK(MIMPI_Ibarrier(&requests[1]));
+    ASSERT_MIMPI_OK(MIMPI_Ireduce(&mine, &reduced, 1, MIMPI_SUM, 0,
+        &requests[2]));
+
+    int token = world_rank;
+    int received = -1;
+    if (world_size > 1) {
+        MIMPI_Request ring;
+        ASSERT_MIMPI_OK(MIMPI_Irecv(&received, sizeof(int), prev, 1, &ring));
+        ASSERT_MIMPI_OK(MIMPI_Send(&token, sizeof(int), next, 1));
+        ASSERT_MIMPI_OK(MIMPI_Wait(&ring));
+        assert(received == prev);
+    }
+
+    ASSERT_MIMPI_OK(MIMPI_Waitall(3, requests));
+    assert(filled(data, LARGE, 7));
+    if (world_rank == 0) {
+        assert(reduced == (unsigned char) (world_size * (world_size - 1) / 2));
+    }
+
+    // Polling until a reduction of a large vector completes.
+    fill(data, LARGE, world_rank);
+    MIMPI_Request request;
+    ASSERT_MIMPI_OK(MIMPI_Ireduce(data, sum, LARGE, MIMPI_MAX, root,
+        &request));
+    bool flag = false;
+    while (!flag) {
+        ASSERT_MIMPI_OK(MIMPI_Test(&request, &flag));
+    }
+    assert(request == MIMPI_REQUEST_NULL);
+    if (world_rank == root) {
+        for (int i = 0; i < LARGE; ++i) {
+            unsigned char expected = 0;
+            for (int r = 0; r < world_size; ++r) {
+                unsigned char value = (unsigned char) (i * 13 + r);
+                expected = (value > expected) ? value : expected;
+            }
+            assert(sum[i] == expected);
+        }
+    }
+
+    // A blocking collective started while a non-blocking one is pending.
+    if (world_rank == 0) {
+        fill(data, LARGE, 42);
+    }
+    ASSERT_MIMPI_OK(MIMPI_Ibcast(data, LARGE, 0, &request));
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+    ASSERT_MIMPI_OK(MIMPI_Wait(&request));
+    assert(filled(data, LARGE, 42));
+
+    // A busy rank in the middle of the tree does not hold up the others.
+    if (world_rank == 0) {
+        fill(data, LARGE, 99);
+    }
+    double start = now_ms();
+    ASSERT_MIMPI_OK(MIMPI_Ibcast(data, LARGE, 0, &request));
+    if (world_rank == SLOW_RANK) {
+        usleep(SLOW_MS * 1000);
+    }
+    ASSERT_MIMPI_OK(MIMPI_Wait(&request));
+    if (world_rank != SLOW_RANK) {
+        assert(now_ms() - start < SLOW_MS * 0.8);
+    }
+    assert(filled(data, LARGE, 99));
+
+    assert(MIMPI_Ibcast(data, 1, world_size, &request) ==
+        MIMPI_ERROR_NO_SUCH_RANK);
+
+    free(data);
+    free(sum);
+    MIMPI_Finalize();
+    return 0;
+}
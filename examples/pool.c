@@ -0,0 +1,86 @@
+/*
+The purpose of this example is to check the memory pool behind buffered
+messages. Rank 1 floods rank 0 with small messages in several rounds, which
+must be served by the same slabs once the first round has allocated them.
+Then rank 1 sends messages rank 0 never receives: MIMPI_Finalize must release
+them, so that the heap is as small as before MIMPI_Init.
+*/
+
+#include <assert.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define ROUNDS 5
+#define MESSAGES 200
+#define SIZE 1000
+#define LEFT 500
+
+int main(int argc, char **argv)
+{
+    size_t const heap_before = mallinfo2().uordblks;
+
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+
+    char data[SIZE];
+    memset(data, world_rank, SIZE);
+
+    MIMPI_Pool_stats first;
+    unsigned long long allocs = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        if (world_rank == 1) {
+            for (int i = 0; i < MESSAGES; ++i) {
+                ASSERT_MIMPI_OK(MIMPI_Send(data, SIZE, 0, 1));
+            }
+            ASSERT_MIMPI_OK(MIMPI_Send(data, 1, 0, 3));
+        }
+        else if (world_rank == 0) {
+            // Arrives after the whole round, which is buffered by then.
+            ASSERT_MIMPI_OK(MIMPI_Recv(data, 1, 1, 3));
+            for (int i = 0; i < MESSAGES; ++i) {
+                ASSERT_MIMPI_OK(MIMPI_Recv(data, SIZE, 1, 1));
+                assert(data[SIZE - 1] == 1);
+            }
+        }
+
+        // Read before the barrier lets rank 1 send the next round.
+        MIMPI_Pool_stats stats;
+        MIMPI_Get_pool_stats(&stats);
+        if (round == 0) {
+            first = stats;
+        }
+        else if (world_rank == 0) {
+            assert(stats.allocs >= allocs + MESSAGES);
+            // Each round would take as many slabs as the first one without
+            // reuse. A control block of a size not seen yet may still need
+            // a slab of its own.
+            assert(stats.slabs <= first.slabs + 2);
+        }
+        allocs = stats.allocs;
+        ASSERT_MIMPI_OK(MIMPI_Barrier());
+    }
+
+    if (world_rank == 1) {
+        for (int i = 0; i < LEFT; ++i) {
+            ASSERT_MIMPI_OK(MIMPI_Send(data, SIZE, 0, 2));
+        }
+        ASSERT_MIMPI_OK(MIMPI_Send(data, 1, 0, 3));
+    }
+    else if (world_rank == 0) {
+        ASSERT_MIMPI_OK(MIMPI_Recv(data, 1, 1, 3));
+        MIMPI_Pool_stats stats;
+        MIMPI_Get_pool_stats(&stats);
+        assert(stats.in_use >= LEFT);
+        assert(stats.slabs > first.slabs);
+    }
+
+    MIMPI_Finalize();
+
+    size_t const heap_after = mallinfo2().uordblks;
+    assert(heap_after < heap_before + 64 * 1024);
+    return 0;
+}
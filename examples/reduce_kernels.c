@@ -0,0 +1,74 @@
+/*
+The purpose of this example is to compare the kernels of MIMPI_Reduce.
+Every kernel supported by the CPU is checked against the scalar one and
+timed on a vector of the size given as the first argument (16 MiB by
+default). It runs without mimpirun.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../mimpi_reduce.h"
+
+#define ROUNDS 8
+
+static char const *const op_names[] = {"MAX", "MIN", "SUM", "PROD"};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    size_t const size = (argc > 1) ? strtoull(argv[1], NULL, 10) : (16 << 20);
+    uint8_t *other = malloc(size);
+    uint8_t *expected = malloc(size);
+    uint8_t *acc = malloc(size);
+    assert(other && expected && acc);
+
+    for (size_t i = 0; i < size; ++i) {
+        other[i] = (uint8_t) (i * 7 + 3);
+    }
+
+    printf("%-6s %-5s %10s %9s\n", "kernel", "op", "MiB/s", "speedup");
+    for (MIMPI_Op op = MIMPI_MAX; op <= MIMPI_PROD; ++op) {
+        double scalar_time = 0;
+        for (reduce_isa isa = REDUCE_SCALAR; isa < REDUCE_ISA_COUNT; ++isa) {
+            if (!reduceSupported(isa)) {
+                continue;
+            }
+            reduceSelect(isa);
+
+            // Unaligned pointers exercise the loads and the scalar tails.
+            for (size_t i = 0; i < size; ++i) {
+                acc[i] = (uint8_t) (i * 13 + 1);
+            }
+            reduceInto(acc + 1, other + 1, size - 1, MIMPI_UINT8, op);
+            if (isa == REDUCE_SCALAR) {
+                memcpy(expected, acc, size);
+            }
+            assert(memcmp(expected, acc, size) == 0);
+
+            double start = now();
+            for (int round = 0; round < ROUNDS; ++round) {
+                reduceInto(acc, other, size, MIMPI_UINT8, op);
+            }
+            double time = (now() - start) / ROUNDS;
+            if (isa == REDUCE_SCALAR) {
+                scalar_time = time;
+            }
+
+            printf("%-6s %-5s %10.0f %8.1fx\n", reduceName(isa), op_names[op],
+                size / time / (1 << 20), scalar_time / time);
+        }
+    }
+
+    free(other);
+    free(expected);
+    free(acc);
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*
+The purpose of this example is to test messages above the eager threshold:
+announced messages received out of order, head-to-head exchanges, a pending
+send crossing a barrier and a send to a rank that leaves without receiving.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define BIG (1 << 20)
+#define ANNOUNCED 4
+
+static char out[ANNOUNCED][BIG];
+static char in[ANNOUNCED][BIG];
+
+static void check(char const *buf, char value) {
+    for (int i = 0; i < BIG; i += 4099) {
+        assert(buf[i] == value);
+    }
+    assert(buf[BIG - 1] == value);
+}
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+
+    for (int i = 0; i < ANNOUNCED; ++i) {
+        memset(out[i], world_rank * ANNOUNCED + i + 1, BIG);
+    }
+
+    // Announced messages wait unexpected until received in reverse order.
+    if (world_rank == 1) {
+        MIMPI_Request requests[ANNOUNCED];
+        for (int i = 0; i < ANNOUNCED; ++i) {
+            ASSERT_MIMPI_OK(MIMPI_Isend(out[i], BIG, 0, i + 1, &requests[i]));
+        }
+        ASSERT_MIMPI_OK(MIMPI_Waitall(ANNOUNCED, requests));
+    } else if (world_rank == 0) {
+        for (int i = ANNOUNCED - 1; i >= 0; --i) {
+            ASSERT_MIMPI_OK(MIMPI_Recv(in[i], BIG, 1, i + 1));
+            check(in[i], ANNOUNCED + i + 1);
+        }
+    }
+
+    // Both sides send first and receive later.
+    if (world_rank < 2) {
+        int const peer = 1 - world_rank;
+        MIMPI_Request request;
+        ASSERT_MIMPI_OK(MIMPI_Isend(out[0], BIG, peer, 7, &request));
+        ASSERT_MIMPI_OK(MIMPI_Recv(in[0], BIG, peer, 7));
+        ASSERT_MIMPI_OK(MIMPI_Wait(&request));
+        check(in[0], peer * ANNOUNCED + 1);
+    }
+
+    // The payload travels while its sender sits in the barrier.
+    MIMPI_Request pending = MIMPI_REQUEST_NULL;
+    if (world_rank == 1) {
+        ASSERT_MIMPI_OK(MIMPI_Isend(out[1], BIG, 0, 8, &pending));
+    } else if (world_rank == 0) {
+        ASSERT_MIMPI_OK(MIMPI_Recv(in[1], BIG, 1, 8));
+        check(in[1], ANNOUNCED + 2);
+    }
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+    ASSERT_MIMPI_OK(MIMPI_Wait(&pending));
+
+    // Rank 0 leaves without clearing anything. Others first wait for it to
+    // be gone, as a send could otherwise still be announced before it is.
+    if (world_rank != 0) {
+        char byte;
+        assert(MIMPI_Recv(&byte, 1, 0, 9) == MIMPI_ERROR_REMOTE_FINISHED);
+        assert(MIMPI_Send(out[2], BIG, 0, 9) == MIMPI_ERROR_REMOTE_FINISHED);
+    }
+
+    MIMPI_Finalize();
+    return 0;
+}
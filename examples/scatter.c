@@ -0,0 +1,81 @@
+/*
+The purpose of this example is to test scatters from every root in turn,
+with blocks of equal and of various sizes, some of them empty.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+static unsigned char value(int rank, int i) {
+    return (unsigned char) (rank * 37 + i * 11 + 1);
+}
+
+/* Block of rank r in the variable case; every third one is empty. */
+static int length(int rank, int count) {
+    return (rank % 3 == 2) ? 0 : count + rank * 101;
+}
+
+static void check(int count, int world_rank, int world_size) {
+    size_t total = 0;
+    for (int r = 0; r < world_size; ++r) {
+        total += count + length(r, count);
+    }
+    unsigned char *data = malloc(total + 1);
+    unsigned char *block = malloc(count + length(world_rank, count) + 1);
+    int *counts = malloc(world_size * sizeof(int));
+    int *displs = malloc(world_size * sizeof(int));
+    assert(data && block && counts && displs);
+
+    for (int root = 0; root < world_size; ++root) {
+        for (int r = 0; r < world_size; ++r) {
+            for (int i = 0; i < count; ++i) {
+                data[r * count + i] = (world_rank == root) ? value(r, i) : 0;
+            }
+        }
+        ASSERT_MIMPI_OK(MIMPI_Scatter(data, block, count, root));
+        for (int i = 0; i < count; ++i) {
+            assert(block[i] == value(world_rank, i));
+        }
+
+        // Blocks in reverse order of ranks, to exercise the displacements.
+        int offset = 0;
+        for (int r = world_size - 1; r >= 0; --r) {
+            counts[r] = length(r, count);
+            displs[r] = offset;
+            for (int i = 0; i < counts[r]; ++i) {
+                data[offset + i] = (world_rank == root) ? value(r, i) : 0;
+            }
+            offset += counts[r];
+        }
+        ASSERT_MIMPI_OK(MIMPI_Scatterv(data,
+            (world_rank == root) ? counts : NULL,
+            (world_rank == root) ? displs : NULL, block, root));
+        for (int i = 0; i < length(world_rank, count); ++i) {
+            assert(block[i] == value(world_rank, i));
+        }
+    }
+
+    free(data);
+    free(block);
+    free(counts);
+    free(displs);
+}
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    check(0, world_rank, world_size);
+    check(1, world_rank, world_size);
+    check(1000, world_rank, world_size);
+    check(100 * 1000 + 3, world_rank, world_size);
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+The purpose of this example is to produce a trace of every kind of event:
+small and rendezvous-sized messages between neighbours in a ring,
+non-blocking receives, collectives run by the application thread and in the
+background, and a split of the world.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define ROUNDS 10
+#define LARGE (256 * 1024)
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+    int const next = (world_rank + 1) % world_size;
+    int const prev = (world_rank + world_size - 1) % world_size;
+
+    char *data = malloc(LARGE);
+    assert(data);
+    memset(data, world_rank, LARGE);
+
+    if (world_size > 1) {
+        for (int i = 0; i < ROUNDS; ++i) {
+            int token = world_rank;
+            MIMPI_Request request;
+            ASSERT_MIMPI_OK(MIMPI_Irecv(&token, sizeof(int), prev, i,
+                &request));
+            int const mine = world_rank;
+            ASSERT_MIMPI_OK(MIMPI_Send(&mine, sizeof(int), next, i));
+            ASSERT_MIMPI_OK(MIMPI_Wait(&request));
+            assert(token == prev);
+        }
+
+        // Even ranks send first, so that odd ones wait in MIMPI_Recv.
+        if (world_rank % 2 == 0 && next != 0) {
+            ASSERT_MIMPI_OK(MIMPI_Send(data, LARGE, next, ROUNDS));
+        }
+        else if (world_rank % 2 == 1) {
+            ASSERT_MIMPI_OK(MIMPI_Recv(data, LARGE, prev, ROUNDS));
+            assert(data[LARGE - 1] == prev);
+        }
+    }
+
+    ASSERT_MIMPI_OK(MIMPI_Barrier());
+    ASSERT_MIMPI_OK(MIMPI_Bcast(data, LARGE, 0));
+    assert(data[0] == 0);
+    unsigned char one = 1;
+    unsigned char sum = 0;
+    ASSERT_MIMPI_OK(MIMPI_Allreduce(&one, &sum, 1, MIMPI_SUM));
+    assert(sum == world_size);
+
+    MIMPI_Request request;
+    ASSERT_MIMPI_OK(MIMPI_Ibarrier(&request));
+    ASSERT_MIMPI_OK(MIMPI_Wait(&request));
+
+    MIMPI_Comm half;
+    ASSERT_MIMPI_OK(MIMPI_Comm_split(MIMPI_COMM_WORLD, world_rank % 2, 0,
+        &half));
+    ASSERT_MIMPI_OK(MIMPI_Barrier_comm(half));
+    MIMPI_Comm_free(&half);
+
+    free(data);
+    MIMPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+The purpose of this example is to test reductions of every datatype,
+with vectors spanning several segments, to every root in turn, and the
+rejection of datatypes and operations out of their enums.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "../mimpi.h"
+#include "mimpi_err.h"
+
+#define COUNT 10007
+
+static int64_t value(int rank, int i) {
+    return (rank % 2 == 0) ? (rank + i % 5) : -(rank + i % 3);
+}
+
+#define CHECK_TYPE(type, datatype) \
+    do { \
+        type *data = malloc(COUNT * sizeof(type)); \
+        type *result = malloc(COUNT * sizeof(type)); \
+        assert(data && result); \
+        for (int i = 0; i < COUNT; ++i) { \
+            data[i] = (type) value(world_rank, i); \
+        } \
+        for (MIMPI_Op op = MIMPI_MAX; op <= MIMPI_PROD; ++op) { \
+            ASSERT_MIMPI_OK(MIMPI_Reduce_typed(data, result, COUNT, \
+                datatype, op, root)); \
+            if (world_rank != root) { \
+                continue; \
+            } \
+            for (int i = 0; i < COUNT; ++i) { \
+                type expected = (type) value(0, i); \
+                for (int r = 1; r < world_size; ++r) { \
+                    type v = (type) value(r, i); \
+                    switch (op) { \
+                    case MIMPI_MAX: expected = (v > expected) ? v : expected; break; \
+                    case MIMPI_MIN: expected = (v < expected) ? v : expected; break; \
+                    case MIMPI_SUM: expected += v; break; \
+                    case MIMPI_PROD: expected *= v; break; \
+                    } \
+                } \
+                assert(result[i] == expected); \
+            } \
+        } \
+        free(data); \
+        free(result); \
+    } while (0)
+
+int main(int argc, char **argv)
+{
+    MIMPI_Init(false);
+
+    int const world_rank = MIMPI_World_rank();
+    int const world_size = MIMPI_World_size();
+
+    for (int root = 0; root < world_size; ++root) {
+        CHECK_TYPE(uint8_t, MIMPI_UINT8);
+        CHECK_TYPE(int32_t, MIMPI_INT32);
+        CHECK_TYPE(int64_t, MIMPI_INT64);
+        CHECK_TYPE(uint64_t, MIMPI_UINT64);
+        CHECK_TYPE(float, MIMPI_FLOAT);
+        CHECK_TYPE(double, MIMPI_DOUBLE);
+    }
+
+    int64_t data = 1;
+    int64_t result;
+    assert(MIMPI_Reduce_typed(&data, &result, 1, (MIMPI_Datatype) -1, 
+        MIMPI_SUM, 0) == MIMPI_ERROR_INVALID_ARGUMENT);
+    assert(MIMPI_Reduce_typed(&data, &result, 1, MIMPI_DOUBLE + 1, 
+        MIMPI_SUM, 0) == MIMPI_ERROR_INVALID_ARGUMENT);
+    assert(MIMPI_Allreduce_typed(&data, &result, 1, (MIMPI_Datatype) 1000, 
+        MIMPI_SUM) == MIMPI_ERROR_INVALID_ARGUMENT);
+    assert(MIMPI_Allreduce_typed(&data, &result, 1, MIMPI_INT64, 
+        MIMPI_PROD + 1) == MIMPI_ERROR_INVALID_ARGUMENT);
+    assert(MIMPI_Reduce_comm(&data, &result, 1, (MIMPI_Datatype) -7, 
+        MIMPI_MAX, 0, MIMPI_COMM_WORLD) == MIMPI_ERROR_INVALID_ARGUMENT);
+    // Nothing was sent, so a valid reduction still works.
+    ASSERT_MIMPI_OK(MIMPI_Allreduce_typed(&data, &result, 1, MIMPI_INT64, 
+        MIMPI_SUM));
+    assert(result == world_size);
+
+    MIMPI_Finalize();
+    return 0;
+}
@@ -5,6 +5,8 @@
 #include "channel.h"
 #include "mimpi.h"
 #include "mimpi_common.h"
+#include "mimpi_reduce.h"
+#include "mimpi_trace.h"
 
 #include <errno.h>
 #include <stdarg.h>
@@ -39,15 +41,23 @@ void MIMPI_Init(bool enable_deadlock_detection) {
     setMyRank(my_no);
     setWorldSize(world);
     setDeadlocks(enable_deadlock_detection);
+    loadFdTable();
     initListsAndVariables();
     initMutexes();
-    createReaders();
+    traceInit(my_no, world);
+    startProgressEngine();
 }
 
 void MIMPI_Finalize() {
+    stopCollectives();
     closeGroupPipes();
+    reportFlowStats();
+    flushDetachedSends();
+    stopWriter();
     closeWritingPointToPointPipes();
-    waitForReaders();
+    stopProgressEngine();
+    traceFinish();
+    reportPoolStats();
     closeReadingPointToPointPipes();
     destroyMutexes();
     cleanListsAndVariables();
@@ -69,58 +79,567 @@ MIMPI_Retcode MIMPI_Send(
     int destination,
     int tag
 ) {
-    if (destination == my_no) {
+    return MIMPI_Send_comm(data, count, destination, tag, MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Recv(
+    void *data,
+    int count,
+    int source,
+    int tag
+) {
+    return MIMPI_Recv_comm(data, count, source, tag, MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Isend(
+    void const *data,
+    int count,
+    int destination,
+    int tag,
+    MIMPI_Request *request
+) {
+    return MIMPI_Isend_comm(data, count, destination, tag, MIMPI_COMM_WORLD, 
+        request);
+}
+
+MIMPI_Retcode MIMPI_Irecv(
+    void *data,
+    int count,
+    int source,
+    int tag,
+    MIMPI_Request *request
+) {
+    return MIMPI_Irecv_comm(data, count, source, tag, MIMPI_COMM_WORLD, 
+        request);
+}
+
+MIMPI_Retcode MIMPI_Wait(MIMPI_Request *request) {
+    TRACE(TRACE_WAIT, TRACE_BEGIN, -1, 0, 0, 0);
+    MIMPI_Retcode ret = Wait(request);
+    TRACE(TRACE_WAIT, TRACE_END, -1, 0, 0, ret);
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Test(MIMPI_Request *request, bool *flag) {
+    return Test(request, flag);
+}
+
+MIMPI_Retcode MIMPI_Waitall(int count, MIMPI_Request requests[]) {
+    TRACE(TRACE_WAITALL, TRACE_BEGIN, -1, 0, 0, 0);
+    MIMPI_Retcode ret = Waitall(count, requests);
+    TRACE(TRACE_WAITALL, TRACE_END, -1, 0, 0, ret);
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Waitany(int count, MIMPI_Request requests[], int *index) {
+    TRACE(TRACE_WAITANY, TRACE_BEGIN, -1, 0, 0, 0);
+    MIMPI_Retcode ret = Waitany(count, requests, index);
+    TRACE(TRACE_WAITANY, TRACE_END, -1, 0, 0, ret);
+    return ret;
+}
+
+void MIMPI_Get_flow_stats(MIMPI_Flow_stats *stats) {
+    FlowStats(stats);
+}
+
+void MIMPI_Get_pool_stats(MIMPI_Pool_stats *stats) {
+    PoolStats(stats);
+}
+
+MIMPI_Retcode MIMPI_Barrier() {
+    return MIMPI_Barrier_comm(MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Bcast(
+    void *data,
+    int count,
+    int root
+) {
+    return MIMPI_Bcast_comm(data, count, root, MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Reduce(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Op op,
+    int root
+) {
+    return MIMPI_Reduce_comm(send_data, recv_data, count, MIMPI_UINT8, op, 
+        root, MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Reduce_typed(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Datatype datatype,
+    MIMPI_Op op,
+    int root
+) {
+    return MIMPI_Reduce_comm(send_data, recv_data, count, datatype, op, 
+        root, MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Allreduce(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Op op
+) {
+    return MIMPI_Allreduce_comm(send_data, recv_data, count, MIMPI_UINT8, op, 
+        MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Allreduce_typed(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Datatype datatype,
+    MIMPI_Op op
+) {
+    return MIMPI_Allreduce_comm(send_data, recv_data, count, datatype, op, 
+        MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Gather(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    int root
+) {
+    return MIMPI_Gather_comm(send_data, recv_data, count, root, 
+        MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Allgather(
+    void const *send_data,
+    void *recv_data,
+    int count
+) {
+    return MIMPI_Allgather_comm(send_data, recv_data, count, 
+        MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Scatter(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    int root
+) {
+    return MIMPI_Scatter_comm(send_data, recv_data, count, root, 
+        MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Scatterv(
+    void const *send_data,
+    const int *counts,
+    const int *displs,
+    void *recv_data,
+    int root
+) {
+    return MIMPI_Scatterv_comm(send_data, counts, displs, recv_data, root, 
+        MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Alltoall(
+    void const *send_data,
+    void *recv_data,
+    int count
+) {
+    return MIMPI_Alltoall_comm(send_data, recv_data, count, MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Alltoallv(
+    void const *send_data,
+    const int *send_counts,
+    const int *send_displs,
+    void *recv_data,
+    const int *recv_counts,
+    const int *recv_displs
+) {
+    return MIMPI_Alltoallv_comm(send_data, send_counts, send_displs, 
+        recv_data, recv_counts, recv_displs, MIMPI_COMM_WORLD);
+}
+
+MIMPI_Retcode MIMPI_Ibarrier(MIMPI_Request *request) {
+    Ibarrier(request);
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode MIMPI_Ibcast(
+    void *data,
+    int count,
+    int root,
+    MIMPI_Request *request
+) {
+    if (root >= world || root < 0) {
+        return MIMPI_ERROR_NO_SUCH_RANK;
+    }
+    Ibcast(data, count, root, request);
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode MIMPI_Ireduce(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Op op,
+    int root,
+    MIMPI_Request *request
+) {
+    if (root >= world || root < 0) {
+        return MIMPI_ERROR_NO_SUCH_RANK;
+    }
+    if (!reduceValid(MIMPI_UINT8, op)) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    Ireduce(send_data, recv_data, count, op, root, request);
+    return MIMPI_SUCCESS;
+}
+
+int MIMPI_Comm_rank(MIMPI_Comm comm) {
+    return (comm == MIMPI_COMM_NULL) ? -1 : CommRank(comm);
+}
+
+int MIMPI_Comm_size(MIMPI_Comm comm) {
+    return (comm == MIMPI_COMM_NULL) ? -1 : CommSize(comm);
+}
+
+MIMPI_Retcode MIMPI_Comm_split(
+    MIMPI_Comm comm,
+    int color,
+    int key,
+    MIMPI_Comm *new_comm
+) {
+    if (comm == MIMPI_COMM_NULL) {
+        *new_comm = MIMPI_COMM_NULL;
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    TRACE(TRACE_COMM_SPLIT, TRACE_BEGIN, -1, 0, 0, 0);
+    waitForCollectives();
+    MIMPI_Retcode ret = CommSplit(comm, color, key, new_comm);
+    TRACE(TRACE_COMM_SPLIT, TRACE_END, -1, 0, 0, ret);
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Comm_dup(MIMPI_Comm comm, MIMPI_Comm *new_comm) {
+    if (comm == MIMPI_COMM_NULL) {
+        *new_comm = MIMPI_COMM_NULL;
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    TRACE(TRACE_COMM_SPLIT, TRACE_BEGIN, -1, 0, 0, 0);
+    waitForCollectives();
+    MIMPI_Retcode ret = CommDup(comm, new_comm);
+    TRACE(TRACE_COMM_SPLIT, TRACE_END, -1, 0, 0, ret);
+    return ret;
+}
+
+void MIMPI_Comm_free(MIMPI_Comm *comm) {
+    CommFree(comm);
+}
+
+MIMPI_Retcode MIMPI_Send_comm(
+    void const *data,
+    int count,
+    int destination,
+    int tag,
+    MIMPI_Comm comm
+) {
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    if (destination == CommRank(comm)) {
         return MIMPI_ERROR_ATTEMPTED_SELF_OP;
     }
 
-    if (destination >= world || destination < 0) {
+    if (destination >= CommSize(comm) || destination < 0) {
         return MIMPI_ERROR_NO_SUCH_RANK;
     }
 
-    return Send(data, count, destination, tag);
+    TRACE(TRACE_SEND, TRACE_BEGIN, CommWorldRank(comm, destination), tag, 
+        count, 0);
+    MIMPI_Retcode ret = Send(data, count, destination, tag, comm);
+    TRACE(TRACE_SEND, TRACE_END, CommWorldRank(comm, destination), tag, 
+        count, ret);
+    return ret;
 }
 
-MIMPI_Retcode MIMPI_Recv(
+MIMPI_Retcode MIMPI_Recv_comm(
     void *data,
     int count,
     int source,
-    int tag
+    int tag,
+    MIMPI_Comm comm
 ) {
-    if (source == my_no) {
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    if (source == CommRank(comm)) {
         return MIMPI_ERROR_ATTEMPTED_SELF_OP;
     }
 
-    if (source >= world || source < 0) {
+    if (source >= CommSize(comm) || source < 0) {
         return MIMPI_ERROR_NO_SUCH_RANK;
     }
 
-   return Search(data, count, source, tag);
+    TRACE(TRACE_RECV, TRACE_BEGIN, CommWorldRank(comm, source), tag, count, 
+        0);
+    MIMPI_Retcode ret = Recv(data, count, source, tag, comm);
+    TRACE(TRACE_RECV, TRACE_END, CommWorldRank(comm, source), tag, count, 
+        ret);
+    return ret;
 }
 
-MIMPI_Retcode MIMPI_Barrier() {
-    return Barrier();
+MIMPI_Retcode MIMPI_Barrier_comm(MIMPI_Comm comm) {
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    TRACE(TRACE_BARRIER, TRACE_BEGIN, -1, 0, 0, 0);
+    waitForCollectives();
+    MIMPI_Retcode ret = Barrier(comm);
+    TRACE(TRACE_BARRIER, TRACE_END, -1, 0, 0, ret);
+    return ret;
 }
 
-MIMPI_Retcode MIMPI_Bcast(
+MIMPI_Retcode MIMPI_Bcast_comm(
     void *data,
     int count,
-    int root
+    int root,
+    MIMPI_Comm comm
 ) {
-    if (root >= world || root < 0) {
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    if (root >= CommSize(comm) || root < 0) {
         return MIMPI_ERROR_NO_SUCH_RANK;
     }
-    return Bcast(data, count, root);
+    TRACE(TRACE_BCAST, TRACE_BEGIN, CommWorldRank(comm, root), 0, count, 0);
+    waitForCollectives();
+    MIMPI_Retcode ret = Bcast(data, count, root, comm);
+    TRACE(TRACE_BCAST, TRACE_END, CommWorldRank(comm, root), 0, count, ret);
+    return ret;
 }
 
-MIMPI_Retcode MIMPI_Reduce(
+MIMPI_Retcode MIMPI_Reduce_comm(
     void const *send_data,
     void *recv_data,
     int count,
+    MIMPI_Datatype datatype,
     MIMPI_Op op,
-    int root
+    int root,
+    MIMPI_Comm comm
 ) {
-    if (root >= world || root < 0) {
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    if (root >= CommSize(comm) || root < 0) {
         return MIMPI_ERROR_NO_SUCH_RANK;
     }
-    return Reduce(send_data, recv_data, count, op, root);
-}
\ No newline at end of file
+    if (!reduceValid(datatype, op)) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    TRACE(TRACE_REDUCE, TRACE_BEGIN, CommWorldRank(comm, root), 0, 
+        count * reduceWidth(datatype), 0);
+    waitForCollectives();
+    MIMPI_Retcode ret = 
+        Reduce(send_data, recv_data, count, datatype, op, root, comm);
+    TRACE(TRACE_REDUCE, TRACE_END, CommWorldRank(comm, root), 0, 
+        count * reduceWidth(datatype), ret);
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Allreduce_comm(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Datatype datatype,
+    MIMPI_Op op,
+    MIMPI_Comm comm
+) {
+    if (comm == MIMPI_COMM_NULL || !reduceValid(datatype, op)) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    TRACE(TRACE_ALLREDUCE, TRACE_BEGIN, -1, 0, count * reduceWidth(datatype), 
+        0);
+    waitForCollectives();
+    MIMPI_Retcode ret = 
+        Allreduce(send_data, recv_data, count, datatype, op, comm);
+    TRACE(TRACE_ALLREDUCE, TRACE_END, -1, 0, count * reduceWidth(datatype), 
+        ret);
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Gather_comm(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    int root,
+    MIMPI_Comm comm
+) {
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    if (root >= CommSize(comm) || root < 0) {
+        return MIMPI_ERROR_NO_SUCH_RANK;
+    }
+    TRACE(TRACE_GATHER, TRACE_BEGIN, CommWorldRank(comm, root), 0, count, 0);
+    waitForCollectives();
+    MIMPI_Retcode ret = Gather(send_data, recv_data, count, root, comm);
+    TRACE(TRACE_GATHER, TRACE_END, CommWorldRank(comm, root), 0, count, ret);
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Allgather_comm(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Comm comm
+) {
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    TRACE(TRACE_ALLGATHER, TRACE_BEGIN, -1, 0, count, 0);
+    waitForCollectives();
+    MIMPI_Retcode ret = Allgather(send_data, recv_data, count, comm);
+    TRACE(TRACE_ALLGATHER, TRACE_END, -1, 0, count, ret);
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Scatter_comm(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    int root,
+    MIMPI_Comm comm
+) {
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    if (root >= CommSize(comm) || root < 0) {
+        return MIMPI_ERROR_NO_SUCH_RANK;
+    }
+    TRACE(TRACE_SCATTER, TRACE_BEGIN, CommWorldRank(comm, root), 0, count, 0);
+    waitForCollectives();
+    MIMPI_Retcode ret = Scatter(send_data, recv_data, count, root, comm);
+    TRACE(TRACE_SCATTER, TRACE_END, CommWorldRank(comm, root), 0, count, ret);
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Scatterv_comm(
+    void const *send_data,
+    const int *counts,
+    const int *displs,
+    void *recv_data,
+    int root,
+    MIMPI_Comm comm
+) {
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    if (root >= CommSize(comm) || root < 0) {
+        return MIMPI_ERROR_NO_SUCH_RANK;
+    }
+    TRACE(TRACE_SCATTER, TRACE_BEGIN, CommWorldRank(comm, root), 0, 0, 0);
+    waitForCollectives();
+    MIMPI_Retcode ret = Scatterv(send_data, counts, displs, recv_data, root, 
+        comm);
+    TRACE(TRACE_SCATTER, TRACE_END, CommWorldRank(comm, root), 0, 0, ret);
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Alltoall_comm(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Comm comm
+) {
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    TRACE(TRACE_ALLTOALL, TRACE_BEGIN, -1, 0, count, 0);
+    waitForCollectives();
+    MIMPI_Retcode ret = Alltoall(send_data, recv_data, count, comm);
+    TRACE(TRACE_ALLTOALL, TRACE_END, -1, 0, count, ret);
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Alltoallv_comm(
+    void const *send_data,
+    const int *send_counts,
+    const int *send_displs,
+    void *recv_data,
+    const int *recv_counts,
+    const int *recv_displs,
+    MIMPI_Comm comm
+) {
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+    TRACE(TRACE_ALLTOALL, TRACE_BEGIN, -1, 0, 0, 0);
+    waitForCollectives();
+    MIMPI_Retcode ret = Alltoallv(send_data, send_counts, send_displs, 
+        recv_data, recv_counts, recv_displs, comm);
+    TRACE(TRACE_ALLTOALL, TRACE_END, -1, 0, 0, ret);
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Isend_comm(
+    void const *data,
+    int count,
+    int destination,
+    int tag,
+    MIMPI_Comm comm,
+    MIMPI_Request *request
+) {
+    *request = MIMPI_REQUEST_NULL;
+
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (destination == CommRank(comm)) {
+        return MIMPI_ERROR_ATTEMPTED_SELF_OP;
+    }
+
+    if (destination >= CommSize(comm) || destination < 0) {
+        return MIMPI_ERROR_NO_SUCH_RANK;
+    }
+
+    TRACE(TRACE_ISEND, TRACE_BEGIN, CommWorldRank(comm, destination), tag, 
+        count, 0);
+    MIMPI_Retcode ret = Isend(data, count, destination, tag, comm, request);
+    TRACE(TRACE_ISEND, TRACE_END, CommWorldRank(comm, destination), tag, 
+        count, ret);
+    return ret;
+}
+
+MIMPI_Retcode MIMPI_Irecv_comm(
+    void *data,
+    int count,
+    int source,
+    int tag,
+    MIMPI_Comm comm,
+    MIMPI_Request *request
+) {
+    *request = MIMPI_REQUEST_NULL;
+
+    if (comm == MIMPI_COMM_NULL) {
+        return MIMPI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (source == CommRank(comm)) {
+        return MIMPI_ERROR_ATTEMPTED_SELF_OP;
+    }
+
+    if (source >= CommSize(comm) || source < 0) {
+        return MIMPI_ERROR_NO_SUCH_RANK;
+    }
+
+    TRACE(TRACE_IRECV, TRACE_BEGIN, CommWorldRank(comm, source), tag, count, 
+        0);
+    MIMPI_Retcode ret = Irecv(data, count, source, tag, comm, request);
+    TRACE(TRACE_IRECV, TRACE_END, CommWorldRank(comm, source), tag, count, 
+        ret);
+    return ret;
+}
@@ -12,8 +12,36 @@ typedef enum {
     MIMPI_ERROR_NO_SUCH_RANK = 2, /// no process with requested rank exists in the world
     MIMPI_ERROR_REMOTE_FINISHED = 3, /// the remote process involved in communication has finished
     MIMPI_ERROR_DEADLOCK_DETECTED = 4, /// a deadlock has been detected
+    MIMPI_ERROR_INVALID_ARGUMENT = 5, /// a datatype or an operation out of its enum, or MIMPI_COMM_NULL
 } MIMPI_Retcode;
 
+/// @brief Handle of a pending non-blocking operation.
+///
+/// Obtained from @ref MIMPI_Isend() or @ref MIMPI_Irecv() and released by
+/// a successful completion check (@ref MIMPI_Wait(), @ref MIMPI_Test(), ...),
+/// which resets it to @ref MIMPI_REQUEST_NULL.
+typedef struct MIMPI_Request_t *MIMPI_Request;
+
+#define MIMPI_REQUEST_NULL ((MIMPI_Request) 0)
+
+/// @brief Handle of a group of processes communicating among themselves.
+///
+/// Processes of a communicator have ranks from 0 to its size - 1. Messages
+/// sent in a communicator only match receives in the same communicator, and
+/// its collectives involve only its processes. Functions without the
+/// `_comm` suffix work in @ref MIMPI_COMM_WORLD. Those with it (and
+/// @ref MIMPI_Comm_split(), @ref MIMPI_Comm_dup()) return
+/// `MIMPI_ERROR_INVALID_ARGUMENT` for `MIMPI_COMM_NULL`.
+typedef struct MIMPI_Comm_t *MIMPI_Comm;
+
+/// Communicator of all processes, with their world ranks.
+extern MIMPI_Comm const MIMPI_COMM_WORLD;
+
+#define MIMPI_COMM_NULL ((MIMPI_Comm) 0)
+
+/// Color of processes that join no communicator in @ref MIMPI_Comm_split().
+#define MIMPI_UNDEFINED (-1)
+
 /// @brief Reduction operation kind.
 ///
 /// Type of operation performed in @ref MIMPI_Reduce().
@@ -24,12 +52,28 @@ typedef enum {
     MIMPI_PROD,
 } MIMPI_Op;
 
+/// @brief Type of elements of data reduced by @ref MIMPI_Reduce_typed().
+typedef enum {
+    MIMPI_UINT8, /// uint8_t, as in @ref MIMPI_Reduce()
+    MIMPI_INT32, /// int32_t, sums and products wrap around
+    MIMPI_INT64, /// int64_t, sums and products wrap around
+    MIMPI_UINT64, /// uint64_t
+    MIMPI_FLOAT, /// float
+    MIMPI_DOUBLE, /// double
+} MIMPI_Datatype;
+
 /// @brief Initialises MIMPI framework in MIMPI programs.
 ///
 /// Opens an _MPI block_, permitting use of other MIMPI procedures.
+/// If `MIMPI_TRACE` names a path prefix, calls and message arrivals are
+/// traced and @ref MIMPI_Finalize() writes them to `<prefix>.<rank>`,
+/// keeping the last `MIMPI_TRACE_EVENTS` (65536 by default) events of every
+/// thread. `mimpirun --trace-json <output> <files>...` merges such files
+/// into a Chrome trace.
 /// @param enable_deadlock_detection - a flag whether deadlock detection
-///        should be enabled or not. Note that this adds a considerable
-///        overhead, so should only be used when needed.
+///        should be enabled or not. Only receives blocked for longer than
+///        `MIMPI_DEADLOCK_DELAY` milliseconds (5 by default) take part, so
+///        communication that does not deadlock pays next to nothing.
 ///
 void MIMPI_Init(bool enable_deadlock_detection);
 
@@ -56,6 +100,11 @@ int MIMPI_World_rank();
 /// Sends @ref count bytes of @ref data to the process with rank @ref destination.
 /// Data is tagged with @ref tag.
 ///
+/// A message nobody receives yet is held in a copy, so the call returns at
+/// once. Once such copies take `MIMPI_DETACHED_LIMIT` bytes (64 MiB unless
+/// the environment variable says otherwise), the call waits for its message
+/// to be received instead.
+///
 /// @param data - data to be sent.
 /// @param count - number of bytes of data to be sent.
 /// @param destination - rank of the process who is to receive the data. 
@@ -103,6 +152,138 @@ MIMPI_Retcode MIMPI_Recv(
     int tag
 );
 
+/// @brief Starts sending data to the specified process.
+///
+/// Non-blocking counterpart of @ref MIMPI_Send. The buffer @ref data must
+/// not be modified until the request completes.
+///
+/// @param data - data to be sent.
+/// @param count - number of bytes of data to be sent.
+/// @param destination - rank of the process who is to receive the data.
+/// @param tag - a discriminant of the data.
+/// @param request - place where the handle of the operation is to be put.
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if the operation was started.
+///         - `MIMPI_ERROR_ATTEMPTED_SELF_OP` if process attempted to send to itself
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           @ref destination in the world.
+///         Errors of the transfer itself are reported on completion.
+///
+MIMPI_Retcode MIMPI_Isend(
+    void const *data,
+    int count,
+    int destination,
+    int tag,
+    MIMPI_Request *request
+);
+
+/// @brief Starts receiving data from the specified process.
+///
+/// Non-blocking counterpart of @ref MIMPI_Recv. Any number of receives may
+/// be pending at once; messages are matched to them in posting order.
+/// The buffer @ref data must not be accessed until the request completes.
+///
+/// @param data - place where received data is to be put.
+/// @param count - number of bytes of data to be received.
+/// @param source - rank of the process for data from we are waiting.
+/// @param tag - a discriminant of the data.
+/// @param request - place where the handle of the operation is to be put.
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if the operation was started.
+///         - `MIMPI_ERROR_ATTEMPTED_SELF_OP` if process attempted to receive from itself
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           @ref source in the world.
+///         Errors of the transfer itself are reported on completion.
+///
+MIMPI_Retcode MIMPI_Irecv(
+    void *data,
+    int count,
+    int source,
+    int tag,
+    MIMPI_Request *request
+);
+
+/// @brief Blocks until the operation behind @ref request completes.
+///
+/// Releases the request and sets it to @ref MIMPI_REQUEST_NULL.
+/// Waiting on @ref MIMPI_REQUEST_NULL returns immediately.
+///
+/// @return MIMPI return code of the completed operation, i.e. the code
+///         the blocking counterpart (@ref MIMPI_Send or @ref MIMPI_Recv)
+///         would have returned, including `MIMPI_ERROR_REMOTE_FINISHED`
+///         and `MIMPI_ERROR_DEADLOCK_DETECTED` of a receive.
+///
+MIMPI_Retcode MIMPI_Wait(MIMPI_Request *request);
+
+/// @brief Checks without blocking whether @ref request has completed.
+///
+/// Sets @ref flag accordingly. A completed request is released as by
+/// @ref MIMPI_Wait and its return code is returned.
+///
+MIMPI_Retcode MIMPI_Test(MIMPI_Request *request, bool *flag);
+
+/// @brief Waits for all @ref count requests in @ref requests.
+///
+/// @return `MIMPI_SUCCESS` if all operations succeeded, otherwise the
+///         return code of the first failed one. All requests are released.
+///
+MIMPI_Retcode MIMPI_Waitall(int count, MIMPI_Request requests[]);
+
+/// @brief Waits for any of @ref count requests in @ref requests.
+///
+/// Puts the position of the completed request in @ref index and releases it.
+/// If no request is active, returns immediately with @ref index set to -1.
+///
+/// @return MIMPI return code of the completed operation.
+///
+MIMPI_Retcode MIMPI_Waitany(int count, MIMPI_Request requests[], int *index);
+
+/// @brief Flow control counters of this process.
+///
+/// Messages a process buffers for this one are limited by the number of
+/// bytes it agreed to (`MIMPI_PEER_BUDGET`, with all peers together limited
+/// by `MIMPI_RANK_BUDGET`), counted as the memory they take there. A message
+/// that finds the budget used up is announced instead and transferred once
+/// the receive is posted. Announcements take some of the budget as well, so
+/// a send that finds too little even for one waits until the process
+/// receives some of the messages.
+typedef struct {
+    unsigned long long eager_sends; /// messages sent within the budget
+    unsigned long long stalled_sends; /// messages that found the budget used up
+    unsigned long long credit_returns; /// budget returns received from peers
+} MIMPI_Flow_stats;
+
+/// @brief Fills @ref stats with the flow control counters of this process.
+///
+/// Counters are also printed to the standard error in @ref MIMPI_Finalize
+/// if the environment variable `MIMPI_FLOW_REPORT` is set (and is not "0").
+///
+void MIMPI_Get_flow_stats(MIMPI_Flow_stats *stats);
+
+/// @brief Memory pool counters of this process.
+///
+/// Descriptors and payloads of buffered messages come from a pool. Blocks
+/// of up to 8 KiB are carved out of 64 KiB slabs and reused once freed,
+/// larger ones are allocated one by one. Everything the pool holds is
+/// released in @ref MIMPI_Finalize, messages nobody received included.
+typedef struct {
+    unsigned long long allocs; /// blocks handed out
+    unsigned long long frees; /// blocks given back
+    unsigned long long in_use; /// blocks handed out and not given back yet
+    unsigned long long slabs; /// slabs allocated for blocks up to 8 KiB
+    unsigned long long large_allocs; /// blocks above 8 KiB
+    unsigned long long bytes_in_use; /// bytes of blocks in use, headers included
+    unsigned long long peak_bytes; /// most bytes in use at any time
+} MIMPI_Pool_stats;
+
+/// @brief Fills @ref stats with the memory pool counters of this process.
+///
+/// Counters of every block size are also printed to the standard error in
+/// @ref MIMPI_Finalize if the environment variable `MIMPI_POOL_REPORT` is
+/// set (and is not "0"), together with what is released there.
+///
+void MIMPI_Get_pool_stats(MIMPI_Pool_stats *stats);
+
 /// @brief Synchronises all processes.
 ///
 /// Blocks execution of the calling process until all processes execute
@@ -175,4 +356,452 @@ MIMPI_Retcode MIMPI_Reduce(
     int root
 );
 
+/// @brief Reduces data of a given type from all processes to one.
+///
+/// Works like @ref MIMPI_Reduce(), except that the data is an array of
+/// @ref count elements of type @ref datatype, which are combined
+/// as numbers of that type.
+///
+/// @param send_data - data to be reduced.
+/// @param recv_data - place where reduction's result is to be put.
+/// @param count - number of elements of data to be reduced.
+/// @param datatype - type of the elements.
+/// @param op - a particular operation to be performed for reduction.
+/// @param root - rank of the process who is to hold the result of reduction.
+///
+/// @return MIMPI return code, the same as of @ref MIMPI_Reduce(), or
+///         `MIMPI_ERROR_INVALID_ARGUMENT` if @ref datatype or @ref op is not
+///         one of the values of its enum.
+///
+MIMPI_Retcode MIMPI_Reduce_typed(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Datatype datatype,
+    MIMPI_Op op,
+    int root
+);
+
+/// @brief Reduces data from all processes to all of them.
+///
+/// Performs reduction of kind @ref op over @ref count bytes of data
+/// stored at address @ref send_data in every process, just like
+/// @ref MIMPI_Reduce(), but puts the same result at @ref recv_data
+/// in every process. Additionally, is a synchronisation point similarly
+/// to @ref MIMPI_Barrier.
+///
+/// @param send_data - data to be reduced.
+/// @param recv_data - place where reduction's result is to be put.
+/// @param count - number of bytes of data to be reduced.
+/// @param op - a particular operation to be performed for reduction.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process in the world
+///            has already escaped _MPI block_.
+///         - `MIMPI_ERROR_DEADLOCK_DETECTED` if a deadlock has been detected
+///           and therefore this call would else never return.
+///
+MIMPI_Retcode MIMPI_Allreduce(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Op op
+);
+
+/// @brief Reduces data of a given type from all processes to all of them.
+///
+/// Works like @ref MIMPI_Allreduce(), except that the data is an array of
+/// @ref count elements of type @ref datatype, as in
+/// @ref MIMPI_Reduce_typed().
+///
+/// @return MIMPI return code, the same as of @ref MIMPI_Allreduce(), or
+///         `MIMPI_ERROR_INVALID_ARGUMENT` as in @ref MIMPI_Reduce_typed().
+///
+MIMPI_Retcode MIMPI_Allreduce_typed(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Datatype datatype,
+    MIMPI_Op op
+);
+
+/// @brief Gathers data from all processes in one.
+///
+/// Collects @ref count bytes of data stored at address @ref send_data
+/// in every process and puts them at @ref recv_data *ONLY* in the process
+/// with rank @ref root, the data of the process with rank i at offset
+/// i * @ref count. Additionally, is a synchronisation point similarly
+/// to @ref MIMPI_Barrier.
+///
+/// @param send_data - data to be gathered.
+/// @param recv_data - place for world size * @ref count bytes of gathered
+///        data, ignored in processes other than @ref root.
+/// @param count - number of bytes of data sent by every process.
+/// @param root - rank of the process who is to hold the gathered data.
+///
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_NO_SUCH_RANK` if there is no process with rank
+///           @ref root in the world.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process in the world
+///            has already escaped _MPI block_.
+///         - `MIMPI_ERROR_DEADLOCK_DETECTED` if a deadlock has been detected
+///           and therefore this call would else never return.
+///
+MIMPI_Retcode MIMPI_Gather(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    int root
+);
+
+/// @brief Gathers data from all processes in all of them.
+///
+/// Works like @ref MIMPI_Gather(), but puts the gathered data at
+/// @ref recv_data in every process.
+///
+/// @param send_data - data to be gathered.
+/// @param recv_data - place for world size * @ref count bytes of gathered
+///        data.
+/// @param count - number of bytes of data sent by every process.
+///
+/// @return MIMPI return code, the same as of @ref MIMPI_Allreduce().
+///
+MIMPI_Retcode MIMPI_Allgather(
+    void const *send_data,
+    void *recv_data,
+    int count
+);
+
+/// @brief Scatters data from one process to all of them.
+///
+/// Splits world size * @ref count bytes of data stored at address
+/// @ref send_data in the process with rank @ref root into blocks of
+/// @ref count bytes and puts the block at offset i * @ref count
+/// at @ref recv_data in the process with rank i. Additionally, is
+/// a synchronisation point similarly to @ref MIMPI_Barrier.
+///
+/// @param send_data - data to be scattered, ignored in processes other than
+///        @ref root.
+/// @param recv_data - place where the block of this process is to be put.
+/// @param count - number of bytes of data received by every process.
+/// @param root - rank of the process who holds the data.
+///
+/// @return MIMPI return code, the same as of @ref MIMPI_Gather().
+///
+MIMPI_Retcode MIMPI_Scatter(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    int root
+);
+
+/// @brief Scatters blocks of various sizes from one process to all of them.
+///
+/// Works like @ref MIMPI_Scatter(), but the process with rank i receives
+/// @ref counts[i] bytes stored at @ref send_data + @ref displs[i]
+/// in the process with rank @ref root.
+///
+/// @param send_data - data to be scattered, ignored in processes other than
+///        @ref root.
+/// @param counts - sizes of the blocks of all processes, only read in
+///        @ref root.
+/// @param displs - offsets of the blocks of all processes in @ref send_data,
+///        only read in @ref root.
+/// @param recv_data - place where the block of this process is to be put.
+/// @param root - rank of the process who holds the data.
+///
+/// @return MIMPI return code, the same as of @ref MIMPI_Gather().
+///
+MIMPI_Retcode MIMPI_Scatterv(
+    void const *send_data,
+    const int *counts,
+    const int *displs,
+    void *recv_data,
+    int root
+);
+
+/// @brief Exchanges blocks of data between all pairs of processes.
+///
+/// Sends the block of @ref count bytes at offset i * @ref count of
+/// @ref send_data to the process with rank i, which puts it at offset
+/// j * @ref count of its @ref recv_data, where j is the rank of the sender.
+/// Additionally, is a synchronisation point similarly to @ref MIMPI_Barrier.
+///
+/// @param send_data - blocks to be sent, one for every process.
+/// @param recv_data - place for blocks received, one from every process.
+/// @param count - number of bytes of every block.
+///
+/// @return MIMPI return code, the same as of @ref MIMPI_Allreduce().
+///
+MIMPI_Retcode MIMPI_Alltoall(
+    void const *send_data,
+    void *recv_data,
+    int count
+);
+
+/// @brief Exchanges blocks of various sizes between all pairs of processes.
+///
+/// Works like @ref MIMPI_Alltoall(), but the block for the process with rank
+/// i has @ref send_counts[i] bytes at @ref send_data + @ref send_displs[i]
+/// and the block from it has @ref recv_counts[i] bytes put at
+/// @ref recv_data + @ref recv_displs[i]. The number of bytes sent from one
+/// process to another must be the same on both sides.
+///
+/// @return MIMPI return code, the same as of @ref MIMPI_Allreduce().
+///
+MIMPI_Retcode MIMPI_Alltoallv(
+    void const *send_data,
+    const int *send_counts,
+    const int *send_displs,
+    void *recv_data,
+    const int *recv_counts,
+    const int *recv_displs
+);
+
+/// @brief Starts @ref MIMPI_Barrier() without waiting for it.
+///
+/// Non-blocking collectives are carried out by a background thread of the
+/// library in the order they were started, so every process must start
+/// them (and the blocking ones) in the same order. A blocking collective
+/// waits until all non-blocking ones started before it have ended.
+/// The outcome is returned by @ref MIMPI_Wait() (or another function
+/// completing @ref request), with the same codes as @ref MIMPI_Barrier().
+///
+/// @param request - place for the handle of the started operation.
+///
+/// @return `MIMPI_SUCCESS`.
+///
+MIMPI_Retcode MIMPI_Ibarrier(MIMPI_Request *request);
+
+/// @brief Starts @ref MIMPI_Bcast() without waiting for it.
+///
+/// Works like @ref MIMPI_Ibarrier(). @ref data must not be accessed until
+/// @ref request completes.
+///
+/// @return `MIMPI_SUCCESS`, or `MIMPI_ERROR_NO_SUCH_RANK` if there is no
+///         process with rank @ref root in the world (then nothing starts).
+///
+MIMPI_Retcode MIMPI_Ibcast(
+    void *data,
+    int count,
+    int root,
+    MIMPI_Request *request
+);
+
+/// @brief Starts @ref MIMPI_Reduce() without waiting for it.
+///
+/// Works like @ref MIMPI_Ibarrier(). @ref send_data must not be modified and
+/// @ref recv_data must not be accessed until @ref request completes.
+///
+/// @return The same codes as @ref MIMPI_Ibcast().
+///
+MIMPI_Retcode MIMPI_Ireduce(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Op op,
+    int root,
+    MIMPI_Request *request
+);
+
+/// @brief Returns the rank of this process in @ref comm,
+///        or -1 for `MIMPI_COMM_NULL`.
+///
+int MIMPI_Comm_rank(MIMPI_Comm comm);
+
+/// @brief Returns the number of processes in @ref comm,
+///        or -1 for `MIMPI_COMM_NULL`.
+///
+int MIMPI_Comm_size(MIMPI_Comm comm);
+
+/// @brief Splits @ref comm into communicators of processes of equal color.
+///
+/// Must be called by all processes of @ref comm, like a collective. Ranks
+/// in each new communicator follow @ref key, and ranks in @ref comm among
+/// equal keys. Collectives of a new communicator take about log2 of its
+/// size steps, however large @ref comm is.
+///
+/// @param comm - communicator to split.
+/// @param color - non-negative color of the communicator to join, or
+///        `MIMPI_UNDEFINED` to join none.
+/// @param key - order of this process in the new communicator.
+/// @param new_comm - place for the new communicator, or `MIMPI_COMM_NULL`
+///        for `MIMPI_UNDEFINED`. It is to be freed with @ref MIMPI_Comm_free().
+/// @return MIMPI return code:
+///         - `MIMPI_SUCCESS` if operation ended successfully.
+///         - `MIMPI_ERROR_REMOTE_FINISHED` if any process in @ref comm
+///            has already escaped _MPI block_.
+///
+MIMPI_Retcode MIMPI_Comm_split(
+    MIMPI_Comm comm,
+    int color,
+    int key,
+    MIMPI_Comm *new_comm
+);
+
+/// @brief Creates a communicator of the processes of @ref comm, in the same
+///        order, whose messages never match those of @ref comm.
+///
+/// Works like @ref MIMPI_Comm_split() with a single color.
+///
+MIMPI_Retcode MIMPI_Comm_dup(MIMPI_Comm comm, MIMPI_Comm *new_comm);
+
+/// @brief Frees a communicator and sets it to `MIMPI_COMM_NULL`.
+///
+/// Freeing `MIMPI_COMM_WORLD` or `MIMPI_COMM_NULL` only does the latter.
+/// Every process frees its handle on its own.
+///
+void MIMPI_Comm_free(MIMPI_Comm *comm);
+
+/// @brief @ref MIMPI_Send() to the process of rank @ref destination
+///        in @ref comm.
+///
+/// `MIMPI_ERROR_NO_SUCH_RANK` means there is no such rank in @ref comm.
+///
+MIMPI_Retcode MIMPI_Send_comm(
+    void const *data,
+    int count,
+    int destination,
+    int tag,
+    MIMPI_Comm comm
+);
+
+/// @brief @ref MIMPI_Recv() of a message sent in @ref comm by the process
+///        of rank @ref source in it.
+///
+MIMPI_Retcode MIMPI_Recv_comm(
+    void *data,
+    int count,
+    int source,
+    int tag,
+    MIMPI_Comm comm
+);
+
+/// @brief @ref MIMPI_Barrier() of the processes of @ref comm.
+MIMPI_Retcode MIMPI_Barrier_comm(MIMPI_Comm comm);
+
+/// @brief @ref MIMPI_Bcast() from the process of rank @ref root in @ref comm.
+MIMPI_Retcode MIMPI_Bcast_comm(
+    void *data,
+    int count,
+    int root,
+    MIMPI_Comm comm
+);
+
+/// @brief @ref MIMPI_Reduce_typed() to the process of rank @ref root
+///        in @ref comm.
+///
+MIMPI_Retcode MIMPI_Reduce_comm(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Datatype datatype,
+    MIMPI_Op op,
+    int root,
+    MIMPI_Comm comm
+);
+
+/// @brief @ref MIMPI_Allreduce_typed() of the processes of @ref comm.
+MIMPI_Retcode MIMPI_Allreduce_comm(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Datatype datatype,
+    MIMPI_Op op,
+    MIMPI_Comm comm
+);
+
+/// @brief @ref MIMPI_Gather() to the process of rank @ref root in @ref comm,
+///        with blocks in the order of ranks in @ref comm.
+///
+MIMPI_Retcode MIMPI_Gather_comm(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    int root,
+    MIMPI_Comm comm
+);
+
+/// @brief @ref MIMPI_Allgather() of the processes of @ref comm, with blocks
+///        in the order of ranks in @ref comm.
+///
+MIMPI_Retcode MIMPI_Allgather_comm(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Comm comm
+);
+
+/// @brief @ref MIMPI_Scatter() from the process of rank @ref root
+///        in @ref comm, with blocks in the order of ranks in @ref comm.
+///
+MIMPI_Retcode MIMPI_Scatter_comm(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    int root,
+    MIMPI_Comm comm
+);
+
+/// @brief @ref MIMPI_Scatterv() from the process of rank @ref root
+///        in @ref comm, with blocks in the order of ranks in @ref comm.
+///
+MIMPI_Retcode MIMPI_Scatterv_comm(
+    void const *send_data,
+    const int *counts,
+    const int *displs,
+    void *recv_data,
+    int root,
+    MIMPI_Comm comm
+);
+
+/// @brief @ref MIMPI_Alltoall() of the processes of @ref comm, with blocks
+///        in the order of ranks in @ref comm.
+///
+MIMPI_Retcode MIMPI_Alltoall_comm(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Comm comm
+);
+
+/// @brief @ref MIMPI_Alltoallv() of the processes of @ref comm, with blocks
+///        in the order of ranks in @ref comm.
+///
+MIMPI_Retcode MIMPI_Alltoallv_comm(
+    void const *send_data,
+    const int *send_counts,
+    const int *send_displs,
+    void *recv_data,
+    const int *recv_counts,
+    const int *recv_displs,
+    MIMPI_Comm comm
+);
+
+/// @brief @ref MIMPI_Isend() to the process of rank @ref destination
+///        in @ref comm.
+///
+MIMPI_Retcode MIMPI_Isend_comm(
+    void const *data,
+    int count,
+    int destination,
+    int tag,
+    MIMPI_Comm comm,
+    MIMPI_Request *request
+);
+
+/// @brief @ref MIMPI_Irecv() of a message sent in @ref comm by the process
+///        of rank @ref source in it.
+///
+MIMPI_Retcode MIMPI_Irecv_comm(
+    void *data,
+    int count,
+    int source,
+    int tag,
+    MIMPI_Comm comm,
+    MIMPI_Request *request
+);
+
 #endif /* MIMPI_H */
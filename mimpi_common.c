@@ -4,14 +4,25 @@
  * */
 
 #include "mimpi_common.h"
+#include "mimpi_pool.h"
+#include "mimpi_transport.h"
+#include "mimpi_reduce.h"
+#include "mimpi_trace.h"
+#include "mimpi_tuning.h"
 
 #include <errno.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/epoll.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 _Noreturn void syserr(const char* fmt, ...)
@@ -56,33 +67,436 @@ typedef struct {
     int root;
 } Reduce_args;
 
+/*
+    Announced messages (rendezvous) carry no data yet, only the id under
+    which their sender will transfer the payload once cleared to send.
+    If the payload comes unsolicited (its sender was finishing), data points
+    to a separate pool block.
+*/
 typedef struct {
     int count;
     int source;
     int tag;
+    int context;
     void* data;
+    bool announced;
+    uint32_t rendezvous_id;
 } MIMPI_message;
 
-typedef struct element {
-    MIMPI_message *message;
-    struct element *next;
+/*
+    Buffered message. Besides the arrival-order list it is linked into two
+    buckets of its source queue: one for its (tag, count) pair and, for user
+    tags, one for its count alone, which serves MIMPI_ANY_TAG lookups.
+*/
+typedef struct message_element {
+    MIMPI_message message;
+    struct message_element *prev;
+    struct message_element *next;
+    struct message_element *key_prev;
+    struct message_element *key_next;
+    struct message_element *count_prev;
+    struct message_element *count_next;
 } messages_node;
 
+/*
+    Messages sharing a key (count, tag and context), in arrival order.
+    Count-only keys use tag 0.
+*/
+typedef struct bucket_element {
+    int count;
+    int tag;
+    int context;
+    messages_node *head;
+    messages_node *tail;
+    struct bucket_element *next;
+} messages_bucket;
+
+/* Unexpected messages from a single source. */
+typedef struct {
+    messages_node *head;
+    messages_node *tail;
+    messages_bucket **table;
+    size_t capacity;
+    size_t buckets;
+} messages_queue;
+
+/*
+    Receive waiting for a message that has not arrived yet. The progress
+    engine streams a matching message straight into data and marks it done.
+    Blocking receives keep it on the stack, MIMPI_Irecv inside its request.
+    A receive matched with an announced message waits on the awaiting list
+    of its source for the payload with rendezvous_id.
+*/
+typedef struct posted_node {
+    void* data;
+    int count;
+    int tag;
+    int context;
+    bool done;
+    uint32_t rendezvous_id;
+    pthread_cond_t cond;
+    struct posted_node *next;
+} posted_recv;
+
+/*
+    Message above the eager threshold. Only its announcement is sent right
+    away; the payload follows once the destination clears it, which happens
+    when a matching receive is posted there. Detached sends (from blocking
+    MIMPI_Send) own a copy of the payload stored right after them and
+    nobody waits for them.
+*/
+typedef struct rendezvous_node {
+    const void* data;
+    int count;
+    int tag;
+    uint32_t id;
+    bool detached;
+    bool cleared;
+    bool done;
+    MIMPI_Retcode result;
+    pthread_cond_t cond;
+    struct rendezvous_node *next;
+} rendezvous_send;
+
+typedef enum {
+    JOB_CLEAR,
+    JOB_PAYLOAD,
+    JOB_CREDIT,
+    JOB_PROBE,
+} writer_job_kind;
+
+#define PROBE_WAIT 0
+#define PROBE_CONFIRM 1
+#define PROBE_DEADLOCK 2
+
+/* A blocking wait of a rank, numbered by its epoch. */
+typedef struct {
+    int32_t rank;
+    uint32_t epoch;
+} wait_hop;
+
+/*
+    Deadlock detection message, the payload of an eager frame with
+    TAG_DEADLOCK. A wait probe follows the wait-for edges: it goes from a
+    blocked receive to the rank it waits for, which passes it on if it is
+    blocked as well, adding its wait to the path. Received counts the
+    messages the sender got from the receiver, so that an edge can be checked
+    against the messages in flight. A wait probe back at its initiator (the
+    first hop) closes a cycle. Ranks on it may have been released since they
+    passed the probe on (by a deadlock of another cycle they were part of),
+    so a confirmation goes around the path the other way, checking that every
+    rank still waits in the same wait. Once it is back, a deadlock notice
+    follows it and ends the waits.
+*/
+typedef struct {
+    uint8_t kind;
+    uint32_t received;
+    uint32_t hops;
+    wait_hop path[];
+} deadlock_probe;
+
+/*
+    Write the progress engine can not do itself, handed to the writer.
+    The id is the seq of an announcement, or the bytes returned by a credit.
+*/
+typedef struct writer_job_node {
+    writer_job_kind kind;
+    int peer;
+    uint32_t id;
+    rendezvous_send* send;
+    deadlock_probe* probe;
+    struct writer_job_node *next;
+} writer_job;
+
+/*
+    Blocking receive of this rank that takes part in deadlock detection.
+    There is at most one: that of the thread which first waited past
+    the deadlock delay.
+*/
+typedef struct {
+    bool blocked;
+    bool deadlocked;
+    int source;
+    uint32_t epoch;
+    posted_recv* request;
+} wait_state;
+
+/*
+    Credit-based flow control. Every ordered pair of ranks starts with the
+    same budget: bytes the receiver is willing to buffer for the sender.
+    Eager frames and announcements use it up by what their messages take
+    from the pool of the receiver, which returns it in credit frames as
+    they are consumed. A sender out of budget backs off from eager to the
+    rendezvous protocol, and waits on credit_cond if there is not even
+    enough for an announcement. Guarded by mutex_list[peer].
+*/
+typedef struct {
+    pthread_cond_t credit_cond;
+    size_t credit;
+    size_t unreturned;
+    uint64_t eager_sends;
+    uint64_t stalled_sends;
+    uint64_t credit_returns;
+} flow_state;
+
+/*
+    Header of every point-to-point message. It travels in the same write as
+    the first payload bytes, so a message of up to FIRST_CHUNK_SIZE bytes
+    costs exactly one chsend and one chrecv.
+
+    The flags say what the frame is. Eager frames carry a whole message.
+    An announcement carries only the tag and the length of a message,
+    a clearance (sent back) and the payload frame that follows it carry
+    the seq of the announcement in place of the tag. A credit frame carries
+    the returned bytes as its length. Eager frames and announcements carry
+    the context of the communicator they were sent in, as only receives in
+    the same communicator may match them.
+*/
+#define FRAME_VERSION 1
+#define FRAME_EAGER 0
+#define FRAME_ANNOUNCE 1
+#define FRAME_CLEAR 2
+#define FRAME_PAYLOAD 3
+#define FRAME_CREDIT 4
+
+typedef struct {
+    uint8_t version;
+    uint8_t flags;
+    uint16_t context;
+    int32_t tag;
+    uint32_t length;
+    uint32_t seq;
+} frame_header;
+
+typedef enum {
+    READ_HEADER,
+    READ_PAYLOAD,
+} reader_stage;
+
+/* Partially received message from a single source. */
+typedef struct {
+    reader_stage stage;
+    frame_header header;
+    uint32_t expected_seq;
+    size_t got;
+    void* buf;
+    messages_node* node;
+    posted_recv* posted;
+    size_t inbox_len;
+    char inbox[];
+} reader_state;
+
+
+/*
+    Neighbours of a rank in the tree of a rooted collective. The tree is
+    the binary heap over ranks rotated so that the root becomes 0.
+*/
+typedef struct {
+    bool ready;
+    int parent;
+    int child_count;
+    int children[2];
+} tree_topology;
+
+/*
+    Group of ranks that run collectives among themselves. Ranks in it are
+    indices into ranks, which holds the world rank of every member. Its
+    context is unique among the communicators of each member, so messages
+    of different communicators never match each other.
+*/
+struct MIMPI_Comm_t {
+    int size;
+    int rank;
+    int* ranks;
+    int context;
+    /* Tree of every root, computed on its first collective. */
+    tree_topology* trees;
+};
+
+/* Algorithms of collectives, in the order of their names in registry. */
+typedef enum {
+    BARRIER_TREE,
+    BARRIER_DISSEMINATION,
+} barrier_algorithm;
+
+typedef enum {
+    BCAST_BINARY,
+    BCAST_BINOMIAL,
+} bcast_algorithm;
+
+typedef enum {
+    REDUCE_BINARY,
+    REDUCE_BINOMIAL,
+} reduce_algorithm;
+
+typedef enum {
+    ALLREDUCE_RECURSIVE_DOUBLING,
+    ALLREDUCE_RING,
+} allreduce_algorithm;
+
+typedef enum {
+    ALLGATHER_RECURSIVE_DOUBLING,
+    ALLGATHER_RING,
+} allgather_algorithm;
+
+#define MAX_ALGORITHMS 2
+
+typedef struct {
+    const char* name;
+    const char* variable;
+    const char* algorithms[MAX_ALGORITHMS + 1];
+} collective_entry;
+
+typedef enum {
+    REQUEST_SEND,
+    REQUEST_RECV,
+    REQUEST_COLLECTIVE,
+} request_kind;
+
+/* What a rank brings to MIMPI_Comm_split, gathered from all of them. */
+typedef struct {
+    int color;
+    int key;
+    int context;
+} split_entry;
+
+/* Member of a communicator being split off, by its rank in the old one. */
+typedef struct {
+    int key;
+    int rank;
+} split_member;
+
+/* Arguments of a non-blocking collective waiting for the collective thread. */
+typedef struct collective_job {
+    collective_kind kind;
+    MIMPI_Comm comm;
+    const void* send_data;
+    void* data;
+    int count;
+    MIMPI_Op op;
+    int root;
+    /* Set under collectives_mutex once the collective has ended. */
+    bool finished;
+    struct collective_job* next;
+} collective_job;
+
+/* State behind a MIMPI_Request handle. */
+struct MIMPI_Request_t {
+    request_kind kind;
+    int peer;
+    bool completed;
+    MIMPI_Retcode result;
+    posted_recv recv;
+    rendezvous_send send;
+    collective_job job;
+};
 
 /************************ VARIABLES ************************/
 #define BUFFER_SIZE 512
+#define FIRST_CHUNK_SIZE (BUFFER_SIZE - sizeof(frame_header))
 static int my_rank = -1;
 static int world_size = 0;
 static bool deadlocks = false;
-static volatile bool has_finished[16] = {false};
-static pthread_mutex_t has_finished_mutex[16];
-static pthread_t readers[16];
-static messages_node* list[16];
-static pthread_mutex_t mutex_list[16];
-static MIMPI_message *waiting_for;
-static pthread_cond_t waiting_for_cond;
-static pthread_mutex_t waiting_for_mutex;
-static volatile bool added = false;
+static fd_table fds;
+static int fds_used = 0;
+/* Per-source state below is guarded by mutex_list[source]. */
+static bool* has_finished;
+static messages_queue* queues;
+static posted_recv** posted;
+static posted_recv** awaiting;
+static rendezvous_send** rendezvous;
+static pthread_mutex_t* mutex_list;
+/* Frames to a destination never interleave: writers hold send_lock[dest]. */
+static pthread_mutex_t* send_lock;
+static uint32_t* send_seq;
+static size_t eager_threshold = EAGER_THRESHOLD_DEFAULT;
+static flow_state* flow;
+/* Payload bytes held by detached sends, at most detached_limit. */
+static size_t detached_limit;
+static _Atomic size_t detached_bytes;
+static int bcast_segment = BCAST_SEGMENT_DEFAULT;
+static int reduce_segment = REDUCE_SEGMENT_DEFAULT;
+static int allreduce_ring = ALLREDUCE_RING_DEFAULT;
+static int allgather_ring = ALLGATHER_RING_DEFAULT;
+static const collective_entry registry[COLLECTIVES] = {
+    [COLLECTIVE_BARRIER] = 
+        {"barrier", BARRIER_VAR, {"tree", "dissemination"}},
+    [COLLECTIVE_BCAST] = 
+        {"bcast", BCAST_VAR, {"binary", "binomial"}},
+    [COLLECTIVE_REDUCE] = 
+        {"reduce", REDUCE_VAR, {"binary", "binomial"}},
+    [COLLECTIVE_ALLREDUCE] = 
+        {"allreduce", ALLREDUCE_VAR, {"recursive_doubling", "ring"}},
+    [COLLECTIVE_ALLGATHER] = 
+        {"allgather", ALLGATHER_VAR, {"recursive_doubling", "ring"}},
+};
+/* Algorithm every collective is pinned to, or -1. */
+static int forced[COLLECTIVES];
+/*
+    Communicators other than the world take the lowest context none of their
+    members uses, and give it back when freed. Frame headers leave room for
+    CONTEXT_LIMIT contexts, those in use by this rank are set in
+    used_contexts.
+*/
+#define WORLD_CONTEXT 0
+#define CONTEXT_LIMIT 65536
+static struct MIMPI_Comm_t world_comm;
+MIMPI_Comm const MIMPI_COMM_WORLD = &world_comm;
+static uint64_t used_contexts[CONTEXT_LIMIT / 64];
+/* Initial credit of every pair, returned in batches of credit_batch bytes. */
+static size_t peer_credit;
+static size_t credit_batch;
+
+/*
+    Messages (eager or announced, probes aside) sent to and received from
+    every peer. Deadlock notices count too, as they end waits like messages
+    do. Sent ones are counted before their frame is written (notices before
+    they are scheduled), received ones once they are matched or queued,
+    under mutex_list[peer]. Deadlock state below is guarded by deadlock_mutex,
+    taken after mutex_list of the source of the blocking receive.
+*/
+static _Atomic uint32_t* sent_messages;
+static uint32_t* received_messages;
+static int deadlock_delay = DEADLOCK_DELAY_DEFAULT;
+/* Longest pause (in milliseconds) between probes of a blocking receive. */
+#define PROBE_INTERVAL_MAX 1000
+static wait_state waiting;
+static uint32_t wait_epochs = 0;
+static pthread_mutex_t deadlock_mutex;
+
+#define ENGINE_EVENTS 64
+static pthread_t engine;
+static int engine_epoll = -1;
+static reader_state** states;
+
+/*
+    The writer thread sends what the progress engine decides to send, so
+    that the engine never blocks on a full pipe and always keeps reading.
+*/
+static pthread_t writer;
+static writer_job* jobs_head = NULL;
+static writer_job* jobs_tail = NULL;
+static bool writer_stop = false;
+static pthread_mutex_t jobs_mutex;
+static pthread_cond_t jobs_cond;
+
+/*
+    Non-blocking collectives run one by one on the collective thread, in the
+    order they were started, which is the same on every rank. Blocking ones
+    wait for it to become idle, so collectives never overlap.
+*/
+static pthread_t collective_thread;
+static collective_job* collectives_head = NULL;
+static collective_job* collectives_tail = NULL;
+static bool collective_running = false;
+static bool collectives_stop = false;
+static pthread_mutex_t collectives_mutex;
+static pthread_cond_t collectives_cond;
+
+/* Bumped on every completion, so MIMPI_Waitany can sleep on all sources. */
+static uint64_t completions = 0;
+static pthread_mutex_t completions_mutex;
+static pthread_cond_t completions_cond;
 
 
 /************************ HELPER FUNCTIONS ************************/
@@ -110,834 +524,3285 @@ static ssize_t tryToGroupReceive(int fd, void* save_to, int count) {
     return ret;
 }
 
-static ssize_t tryToPointSend(int fd, const void* send_from, int count) {
-    ssize_t ret = chsend(fd, send_from, count);
+/*
+    Point-to-point traffic goes through the transport, which may already have
+    consumed part of the stream, so failed calls are not repeated.
+*/
+static ssize_t tryToPointSend(int peer, const void* send_from, size_t count) {
+    ssize_t ret = transportSend(peer, send_from, count);
     if (ret == -1) {
         if (errno == EPIPE) {
             return -1;
         }
-        ASSERT_SYS_OK(chsend(fd, send_from, count));
+        ASSERT_SYS_OK(ret);
     }
     return ret;
 }
 
-static ssize_t tryToPointSendConst(int fd, const void* send_from, int count) {
-    ssize_t ret = chsend(fd, send_from, count);
-    if (ret == -1) {
-        if (errno == EPIPE) {
-            return -1;
-        }
-        ASSERT_SYS_OK(chsend(fd, send_from, count));
+static ssize_t tryToPointReceive(int peer, void* save_to, size_t count) {
+    ssize_t ret = transportRecv(peer, save_to, count);
+    if (ret == 0) {
+        return -1;
     }
+    ASSERT_SYS_OK(ret);
     return ret;
 }
 
-static ssize_t tryToPointReceive(int fd, void* save_to, int count) {
-    ssize_t ret = chrecv(fd, save_to, count);
-    if (ret == 0) {
-        return -1;
+/************************ FILE DESCRIPTOR TABLE ************************/
+void fdTableInit(fd_table* table, int size, int rank, 
+    transport_kind transport) {
+    table -> size = size;
+    table -> rank = rank;
+    table -> length = 2 * size + 7;
+    table -> transport = transport;
+    table -> fds = malloc(table -> length * sizeof(int));
+    if (table -> fds == NULL) {
+        fatal("Could not allocate descriptor table for %d ranks", size);
     }
-    else if (ret < 0) {
-        ASSERT_SYS_OK(chrecv(fd, save_to, count));
+
+    for (int i = 0; i < table -> length; i++) {
+        table -> fds[i] = -1;
     }
-    return ret;
 }
 
-/************************ FUNCTIONS FOR INIT ************************/
-void setMyRank(int rank) {
-    my_rank = rank;
-}
+int fdTableLayout(fd_table* table, int base) {
+    int next = base;
+    int rank = table -> rank;
 
-void setWorldSize(int size) {
-    world_size = size;
-}
+    for (int peer = 0; peer < table -> size; peer++) {
+        if (peer != rank) {
+            FD_IN(table, peer) = next++;
+            FD_OUT(table, peer) = next++;
+        }
+    }
 
-void setDeadlocks(bool deadlock_detection) {
-    deadlocks = deadlock_detection;
-}
+    if (rank != 0) {
+        FD_PARENT_IN(table) = next++;
+        FD_PARENT_OUT(table) = next++;
+    }
 
-void initMutexes() {
-    ASSERT_ZERO(pthread_mutex_init(&waiting_for_mutex, NULL));
+    for (int i = 0; i < 2; i++) {
+        if (TREE_CHILD(rank, i) < table -> size) {
+            FD_CHILD_IN(table, i) = next++;
+            FD_CHILD_OUT(table, i) = next++;
+        }
+    }
 
-    for (int i = 0; i < world_size; i++) {
-        ASSERT_ZERO(pthread_mutex_init(&mutex_list[i], NULL));
-        ASSERT_ZERO(pthread_mutex_init(&has_finished_mutex[i], NULL));
+    if (table -> transport == TRANSPORT_SHM) {
+        FD_SHM(table) = next++;
     }
 
-    ASSERT_ZERO(pthread_cond_init(&waiting_for_cond, NULL));
+    return next - base;
 }
 
-void initListsAndVariables() {
-    waiting_for = malloc(sizeof(MIMPI_message));
-    waiting_for -> tag = -1;
-    waiting_for -> count = -1;
-    waiting_for -> source = -1;
+void fdTableFree(fd_table* table) {
+    free(table -> fds);
+    table -> fds = NULL;
+    table -> length = 0;
+}
 
-    for (int i = 0; i < world_size; i++) {
-        messages_node *guard = malloc(sizeof(messages_node));
-        guard -> message = NULL;
-        guard -> next = NULL;
+/************************ MESSAGE QUEUES ************************/
+#define QUEUE_INITIAL_CAPACITY 16
+
+static size_t bucketHash(int count, int tag, int context, size_t capacity) {
+    uint32_t hash = (uint32_t) count * 2654435761u ^ (uint32_t) tag * 40503u ^ 
+        (uint32_t) context * 2246822519u;
+    return (hash ^ (hash >> 16)) & (capacity - 1);
+}
 
-        list[i] = guard;
+static void queueInit(messages_queue* queue) {
+    queue -> head = NULL;
+    queue -> tail = NULL;
+    queue -> capacity = QUEUE_INITIAL_CAPACITY;
+    queue -> buckets = 0;
+    queue -> table = calloc(queue -> capacity, sizeof(messages_bucket*));
+    if (queue -> table == NULL) {
+        fatal("Could not allocate message index");
     }
 }
 
-/************************ FUNCTIONS FOR FINALIZE ************************/
-void destroyMutexes() {
-    for (int i = 0; i < world_size; i++) {
-        pthread_mutex_destroy(&mutex_list[i]);
-        pthread_mutex_destroy(&has_finished_mutex[i]);
+static void queueGrow(messages_queue* queue) {
+    size_t capacity = 2 * queue -> capacity;
+    messages_bucket** table = calloc(capacity, sizeof(messages_bucket*));
+    if (table == NULL) {
+        fatal("Could not grow message index to %zu buckets", capacity);
     }
 
-    pthread_mutex_destroy(&waiting_for_mutex);
+    for (size_t i = 0; i < queue -> capacity; i++) {
+        messages_bucket* bucket = queue -> table[i];
+        while (bucket != NULL) {
+            messages_bucket* next = bucket -> next;
+            size_t slot = bucketHash(bucket -> count, bucket -> tag, 
+                bucket -> context, capacity);
+            bucket -> next = table[slot];
+            table[slot] = bucket;
+            bucket = next;
+        }
+    }
 
-    pthread_cond_destroy(&waiting_for_cond);
+    free(queue -> table);
+    queue -> table = table;
+    queue -> capacity = capacity;
 }
 
-void waitForReaders() {
-    for (int i = 0; i < world_size; i++) {
-        if (i != my_rank) {
-            pthread_join(readers[i], NULL);
-        }
+static messages_bucket** findBucket(messages_queue* queue, int count, int tag, 
+    int context) {
+    messages_bucket** link = 
+        &queue -> table[bucketHash(count, tag, context, queue -> capacity)];
+    while (*link != NULL && ((*link) -> count != count || 
+        (*link) -> tag != tag || (*link) -> context != context)) {
+        link = &(*link) -> next;
     }
+    return link;
 }
 
-void closeReadingPointToPointPipes() {
-    for (int i = 0; i < world_size; i++) {
-        for (int j = 0; j < world_size; j++) {
-            if (i != j) {
-                if (i == my_rank) {
-                    close((20 * (2 * i + 1)) + j);
-                }
-            }
-        }
-    }
+static messages_node** nextInBucket(messages_node* node, int tag) {
+    return (tag == MIMPI_ANY_TAG) ? &node -> count_next : &node -> key_next;
 }
 
-void closeWritingPointToPointPipes() {
-    for (int i = 0; i < world_size; i++) {
-        for (int j = 0; j < world_size; j++) {
-            if (i != j) {
-                if (j == my_rank) {
-                    close((40 * (i + 1)) + j);
-                }
-            }
-        }
-    }  
+static messages_node** prevInBucket(messages_node* node, int tag) {
+    return (tag == MIMPI_ANY_TAG) ? &node -> count_prev : &node -> key_prev;
 }
 
-void closeGroupPipes() {
-    for (int i = 0; i < 3; i++) {
-        close(700 + 6 * (my_rank + 1) + i);
-        close(700 + 6 * (my_rank + 1) + i - 3);
-    }
+static void bucketAppend(messages_queue* queue, int tag, messages_node* node) {
+    int count = node -> message.count;
+    int context = node -> message.context;
+    messages_bucket** link = findBucket(queue, count, tag, context);
 
-    if (my_rank == 0) {
-        for (int i = 2; i <= world_size; i++) {
-            close(900 + 4 * i + 0);
-            close(900 + 4 * i + 1);
+    if (*link == NULL) {
+        if (queue -> buckets >= 2 * queue -> capacity) {
+            queueGrow(queue);
+            link = findBucket(queue, count, tag, context);
         }
+
+        messages_bucket* bucket = poolAlloc(sizeof(messages_bucket));
+        bucket -> count = count;
+        bucket -> tag = tag;
+        bucket -> context = context;
+        bucket -> head = NULL;
+        bucket -> tail = NULL;
+        bucket -> next = NULL;
+        *link = bucket;
+        queue -> buckets++;
+    }
+
+    messages_bucket* bucket = *link;
+    *nextInBucket(node, tag) = NULL;
+    *prevInBucket(node, tag) = bucket -> tail;
+    if (bucket -> tail != NULL) {
+        *nextInBucket(bucket -> tail, tag) = node;
     }
     else {
-        close(900 + 4 * (my_rank + 1) + 2);
-        close(900 + 4 * (my_rank + 1) + 3);
+        bucket -> head = node;
     }
+    bucket -> tail = node;
 }
 
-void cleanListsAndVariables() {
-    free(waiting_for);
-    messages_node *before;
-    messages_node *after;
-    for (int i = 0; i < world_size; i++) {
-        before = list[i];
-        after = before -> next;
+static void bucketUnlink(messages_queue* queue, int tag, messages_node* node) {
+    messages_bucket** link = findBucket(queue, node -> message.count, tag, 
+        node -> message.context);
+    messages_bucket* bucket = *link;
+    messages_node* prev = *prevInBucket(node, tag);
+    messages_node* next = *nextInBucket(node, tag);
 
-        while (before -> next != NULL) {
-            if (before -> message != NULL) {
-                if (before -> message -> data != NULL) {
-                    free(before -> message -> data);
-                }
-                free(before -> message);
-            }
+    if (prev != NULL) {
+        *nextInBucket(prev, tag) = next;
+    }
+    else {
+        bucket -> head = next;
+    }
 
-            free(before);
-            before = after;
-            after = after -> next;
-        }
+    if (next != NULL) {
+        *prevInBucket(next, tag) = prev;
+    }
+    else {
+        bucket -> tail = prev;
+    }
 
-        if (before -> message != NULL) {
-            if (before -> message -> data != NULL) {
-                free(before -> message -> data);
-            }
-            free(before -> message);
-        }
+    if (bucket -> head == NULL) {
+        *link = bucket -> next;
+        poolFree(bucket);
+        queue -> buckets--;
+    }
+}
+
+/* Appends a message in O(1), indexing it by (tag, count) and by count. */
+static void queuePush(messages_queue* queue, messages_node* node) {
+    node -> next = NULL;
+    node -> prev = queue -> tail;
+    if (queue -> tail != NULL) {
+        queue -> tail -> next = node;
+    }
+    else {
+        queue -> head = node;
+    }
+    queue -> tail = node;
 
-        free(before);
+    bucketAppend(queue, node -> message.tag, node);
+    if (node -> message.tag > 0) {
+        bucketAppend(queue, MIMPI_ANY_TAG, node);
     }
 }
 
-/************************ POINT TO POINT FUNCTIONS ************************/
-static void readerCleanup(int readingFrom) {
-    ASSERT_ZERO(pthread_mutex_lock(&has_finished_mutex[readingFrom]));
-    has_finished[readingFrom] = true;
-    ASSERT_ZERO(pthread_mutex_unlock(&has_finished_mutex[readingFrom]));
+/* Returns the earliest message matching count, tag and context, or NULL. */
+static messages_node* queueFind(messages_queue* queue, int count, int tag, 
+    int context) {
+    messages_bucket* bucket = *findBucket(queue, count, tag, context);
+    return (bucket != NULL) ? bucket -> head : NULL;
+}
 
-    ASSERT_ZERO(pthread_mutex_lock(&waiting_for_mutex));
-    if (waiting_for -> source == readingFrom) {
-        ASSERT_ZERO(pthread_mutex_unlock(&waiting_for_mutex));
-        ASSERT_ZERO(pthread_cond_signal(&waiting_for_cond));
+static void queueRemove(messages_queue* queue, messages_node* node) {
+    if (node -> prev != NULL) {
+        node -> prev -> next = node -> next;
     }
     else {
-        ASSERT_ZERO(pthread_mutex_unlock(&waiting_for_mutex));
+        queue -> head = node -> next;
     }
-}
 
-// THREADS
-static void* Reader(void* _args) {
-    int readingFrom = *(int*) _args;
-    free(_args);
+    if (node -> next != NULL) {
+        node -> next -> prev = node -> prev;
+    }
+    else {
+        queue -> tail = node -> prev;
+    }
 
-    while (true) {
-        int count;
-        if (tryToPointReceive((20 * (2 * my_rank + 1) + readingFrom), 
-            &count, sizeof(int)) == -1) {
-            readerCleanup(readingFrom);
-            pthread_exit(NULL);
-        }
+    bucketUnlink(queue, node -> message.tag, node);
+    if (node -> message.tag > 0) {
+        bucketUnlink(queue, MIMPI_ANY_TAG, node);
+    }
+}
+
+/* Messages and buckets come from the pool, which is swept separately. */
+static void queueFree(messages_queue* queue) {
+    free(queue -> table);
+}
 
-        size_t read_bytes = 0;
-        ssize_t read = 0;
-        void* buf = malloc(count);
+/************************ FUNCTIONS FOR INIT ************************/
+void setMyRank(int rank) {
+    my_rank = rank;
+}
 
-        while (read_bytes < count) {
-            size_t to_read = (count - read_bytes > BUFFER_SIZE) ? BUFFER_SIZE :
-                (count - read_bytes);
+void setWorldSize(int size) {
+    world_size = size;
+}
 
-            read = tryToPointReceive((20 * (2 * my_rank + 1) + readingFrom), 
-                buf + read_bytes, to_read);
+void setDeadlocks(bool deadlock_detection) {
+    deadlocks = deadlock_detection;
+}
 
-            if (read == -1) {
-                free(buf);
-                readerCleanup(readingFrom);
-                pthread_exit(NULL);
-            }
+void loadFdTable() {
+    const char* descriptor = getenv(FD_TABLE_VAR);
+    int base;
+    int count;
+    if (descriptor == NULL || sscanf(descriptor, "%d,%d", &base, &count) != 2) {
+        fatal("Missing or malformed %s, was the program run by mimpirun?",
+            FD_TABLE_VAR);
+    }
 
-            read_bytes += read;
-        }
+    fdTableInit(&fds, world_size, my_rank, transportSelected());
+    fds_used = fdTableLayout(&fds, base);
+    if (fds_used != count) {
+        fatal("Descriptor table of rank %d does not match %s=%s",
+            my_rank, FD_TABLE_VAR, descriptor);
+    }
+    transportInit(&fds);
+}
 
-        int tag;
+void initMutexes() {
+    for (int i = 0; i < world_size; i++) {
+        ASSERT_ZERO(pthread_mutex_init(&mutex_list[i], NULL));
+        ASSERT_ZERO(pthread_mutex_init(&send_lock[i], NULL));
+        ASSERT_ZERO(pthread_cond_init(&flow[i].credit_cond, NULL));
+    }
 
-        if (tryToPointReceive((20 * (2 * my_rank + 1) + readingFrom), 
-            &tag, sizeof(int)) == -1) {
-            free(buf);
-            readerCleanup(readingFrom);
-            pthread_exit(NULL);
-        }
+    ASSERT_ZERO(pthread_mutex_init(&jobs_mutex, NULL));
+    ASSERT_ZERO(pthread_cond_init(&jobs_cond, NULL));
 
-        MIMPI_message *to_save = malloc(sizeof(MIMPI_message));
-        to_save -> data = buf;
-        to_save -> count = count;
-        to_save -> source = readingFrom;
-        to_save -> tag = tag;
+    ASSERT_ZERO(pthread_mutex_init(&completions_mutex, NULL));
+    ASSERT_ZERO(pthread_cond_init(&completions_cond, NULL));
 
-        ASSERT_ZERO(pthread_mutex_lock(&mutex_list[readingFrom]));
-        messages_node *temp = list[readingFrom];
-        while (temp -> next != NULL) {
-            temp = temp -> next;
-        }
+    ASSERT_ZERO(pthread_mutex_init(&collectives_mutex, NULL));
+    ASSERT_ZERO(pthread_cond_init(&collectives_cond, NULL));
 
-        messages_node *new_node = malloc(sizeof(messages_node));
-        temp -> next = new_node;
-        new_node -> message = to_save;
-        new_node -> next = NULL;
+    ASSERT_ZERO(pthread_mutex_init(&deadlock_mutex, NULL));
+}
 
-        ASSERT_ZERO(pthread_mutex_lock(&waiting_for_mutex));
-        if (waiting_for -> count == count && 
-            waiting_for -> source == readingFrom &&
-        (
-            waiting_for -> tag == MIMPI_ANY_TAG ||
-            waiting_for -> tag == tag
-        )) {
-            ASSERT_ZERO(pthread_mutex_unlock(&waiting_for_mutex));
-            added = true;
-            ASSERT_ZERO(pthread_cond_signal(&waiting_for_cond));
-        }
-        else {
-            ASSERT_ZERO(pthread_mutex_unlock(&waiting_for_mutex));
+static int algorithmIndex(collective_kind collective, const char* name) {
+    const char* const* algorithms = registry[collective].algorithms;
+    for (int i = 0; algorithms[i] != NULL; i++) {
+        if (strcmp(algorithms[i], name) == 0) {
+            return i;
         }
+    }
+    return -1;
+}
 
-        ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[readingFrom]));
+static bool knownAlgorithm(const char* collective, const char* algorithm) {
+    for (int i = 0; i < COLLECTIVES; i++) {
+        if (strcmp(registry[i].name, collective) == 0) {
+            return algorithmIndex(i, algorithm) != -1;
+        }
     }
-    pthread_exit(NULL);
+    return false;
 }
 
-static MIMPI_Retcode waitForMessage(int count, int source, int tag) {
-    ASSERT_ZERO(pthread_mutex_lock(&waiting_for_mutex));
-    waiting_for -> count = count;
-    waiting_for -> tag = tag;
-    waiting_for -> source = source;
-    ASSERT_ZERO(pthread_mutex_unlock(&waiting_for_mutex));
+static void loadAlgorithms() {
+    for (int i = 0; i < COLLECTIVES; i++) {
+        forced[i] = -1;
+        const char* name = getenv(registry[i].variable);
+        if (name != NULL) {
+            forced[i] = algorithmIndex(i, name);
+            if (forced[i] == -1) {
+                fatal("Unknown %s=%s", registry[i].variable, name);
+            }
+        }
+    }
+
+    tuningLoad(knownAlgorithm);
+}
 
-    ASSERT_ZERO(pthread_mutex_lock(&has_finished_mutex[source]));
-    while (!added && !has_finished[source]) {
-        ASSERT_ZERO(pthread_mutex_unlock(&has_finished_mutex[source]));
-        ASSERT_ZERO(pthread_cond_wait(&waiting_for_cond, 
-            &mutex_list[source]));
-        ASSERT_ZERO(pthread_mutex_lock(&has_finished_mutex[source]));
+static size_t loadSize(const char* name, size_t fallback) {
+    const char* value = getenv(name);
+    if (value == NULL) {
+        return fallback;
     }
-    ASSERT_ZERO(pthread_mutex_unlock(&has_finished_mutex[source]));
 
-    ASSERT_ZERO(pthread_mutex_lock(&waiting_for_mutex));
-    waiting_for -> tag = -1;
-    waiting_for -> count = -1;
-    waiting_for -> source = -1;
-    ASSERT_ZERO(pthread_mutex_unlock(&waiting_for_mutex));
-    
-    ASSERT_ZERO(pthread_mutex_lock(&has_finished_mutex[source]));
-    if (!added && has_finished[source]) {
-        ASSERT_ZERO(pthread_mutex_unlock(&has_finished_mutex[source]));
-        added = false;
-        return MIMPI_ERROR_REMOTE_FINISHED;
+    char* end;
+    long long size = strtoll(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || size < 0) {
+        fatal("%s must be a non-negative number of bytes", name);
     }
-    ASSERT_ZERO(pthread_mutex_unlock(&has_finished_mutex[source]));
+    return size;
+}
 
-    added = false;
+/*
+    Budget taken by an eager message: its node and payload share a single
+    block at the receiver.
+*/
+static size_t chargeOf(size_t count) {
+    return poolFootprint(sizeof(messages_node) + count);
+}
 
-    return MIMPI_SUCCESS;
+/* Budget taken by an announcement, which waits as a node without payload. */
+static size_t announcementCharge() {
+    return poolFootprint(sizeof(messages_node));
 }
 
-// HELPERS
-MIMPI_Retcode Search(void* data, int count, int source, int tag) {
-    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[source]));
-    messages_node *before_temp = list[source];
-    messages_node *temp = list[source];
-    
-    if (tag != MIMPI_ANY_TAG) {
-        while (temp -> next != NULL && (
-            temp -> message == NULL ||
-            temp -> message -> tag != tag ||
-            temp -> message -> count != count
-        )) {
-            before_temp = temp;
-            temp = temp -> next;
-        }
-
-        if (temp -> message == NULL || 
-            temp -> message -> tag != tag || 
-            temp -> message -> count != count
-        ) {
-            if (waitForMessage(count, source, tag) 
-                == MIMPI_ERROR_REMOTE_FINISHED) {
-                ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[source]));
-                return MIMPI_ERROR_REMOTE_FINISHED;
-            }
-            
-            while (temp -> next != NULL && (
-                temp -> message == NULL ||
-                temp -> message -> tag != tag ||
-                temp -> message -> count != count
-            )) {
-                before_temp = temp;
-                temp = temp -> next;
-            }
-        }        
+/*
+    The budget of a rank is split evenly between its peers, so that all of
+    them together never exceed it. It always fits a single announcement,
+    or no message could ever be sent.
+*/
+static void loadFlowControl() {
+    size_t per_peer = loadSize(PEER_BUDGET_VAR, PEER_BUDGET_DEFAULT);
+    size_t per_rank = loadSize(RANK_BUDGET_VAR, RANK_BUDGET_DEFAULT);
+    if (world_size > 1 && per_rank / (world_size - 1) < per_peer) {
+        per_peer = per_rank / (world_size - 1);
     }
-    else {
-        while (temp -> next != NULL && (
-            temp -> message == NULL ||
-            temp -> message -> count != count
-        )) {
-            before_temp = temp;
-            temp = temp -> next;
-        }
-
-        if (temp -> message == NULL || 
-            temp -> message -> count != count 
-        ) {
-            if (waitForMessage(count, source, MIMPI_ANY_TAG) 
-                == MIMPI_ERROR_REMOTE_FINISHED) {
-                ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[source]));
-                return MIMPI_ERROR_REMOTE_FINISHED;
-            }
 
-            while (temp -> next != NULL && (
-                temp -> message == NULL ||
-                temp -> message -> count != count
-            )) {
-                before_temp = temp;
-                temp = temp -> next;
-            }
-        }
+    if (per_peer < announcementCharge()) {
+        per_peer = announcementCharge();
     }
 
-    memcpy(data, temp -> message -> data, count);
-            
-    before_temp -> next = temp -> next;
-    free(temp -> message -> data);
-    free(temp -> message);
-    free(temp);
-    
-    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[source]));
-
-    return MIMPI_SUCCESS;
+    peer_credit = per_peer;
+    credit_batch = (per_peer / 4 > 0) ? per_peer / 4 : 1;
+    for (int i = 0; i < world_size; i++) {
+        flow[i].credit = peer_credit;
+    }
 }
 
-// EXTERN FUNCTIONS
+void initListsAndVariables() {
+    has_finished = calloc(world_size, sizeof(bool));
+    queues = calloc(world_size, sizeof(messages_queue));
+    posted = calloc(world_size, sizeof(posted_recv*));
+    awaiting = calloc(world_size, sizeof(posted_recv*));
+    rendezvous = calloc(world_size, sizeof(rendezvous_send*));
+    send_seq = calloc(world_size, sizeof(uint32_t));
+    mutex_list = malloc(world_size * sizeof(pthread_mutex_t));
+    send_lock = malloc(world_size * sizeof(pthread_mutex_t));
+    flow = calloc(world_size, sizeof(flow_state));
+    world_comm.size = world_size;
+    world_comm.rank = my_rank;
+    world_comm.ranks = malloc(world_size * sizeof(int));
+    world_comm.context = WORLD_CONTEXT;
+    world_comm.trees = calloc(world_size, sizeof(tree_topology));
+    sent_messages = calloc(world_size, sizeof(_Atomic uint32_t));
+    received_messages = calloc(world_size, sizeof(uint32_t));
+    if (has_finished == NULL || queues == NULL || posted == NULL ||
+        awaiting == NULL || rendezvous == NULL || mutex_list == NULL || 
+        send_lock == NULL || send_seq == NULL || flow == NULL || 
+        world_comm.ranks == NULL || world_comm.trees == NULL || 
+        sent_messages == NULL || 
+        received_messages == NULL) {
+        fatal("Could not allocate per-rank tables for %d ranks", world_size);
+    }
 
-MIMPI_Retcode Send(const void* data, int count, int destination, int tag) {
-    if (tryToPointSend((40 * (destination + 1) + my_rank), 
-        &count, sizeof(count)) == -1) {
-        return MIMPI_ERROR_REMOTE_FINISHED;
+    eager_threshold = loadSize(EAGER_THRESHOLD_VAR, EAGER_THRESHOLD_DEFAULT);
+    loadFlowControl();
+    detached_limit = loadSize(DETACHED_LIMIT_VAR, DETACHED_LIMIT_DEFAULT);
+    atomic_store(&detached_bytes, 0);
+    deadlock_delay = loadSize(DEADLOCK_DELAY_VAR, DEADLOCK_DELAY_DEFAULT);
+
+    bcast_segment = loadSize(BCAST_SEGMENT_VAR, BCAST_SEGMENT_DEFAULT);
+    if (bcast_segment <= 0) {
+        fatal("%s must be a positive number of bytes", BCAST_SEGMENT_VAR);
+    }
+    reduce_segment = loadSize(REDUCE_SEGMENT_VAR, REDUCE_SEGMENT_DEFAULT);
+    if (reduce_segment <= 0) {
+        fatal("%s must be a positive number of bytes", REDUCE_SEGMENT_VAR);
     }
+    allreduce_ring = loadSize(ALLREDUCE_RING_VAR, ALLREDUCE_RING_DEFAULT);
+    allgather_ring = loadSize(ALLGATHER_RING_VAR, ALLGATHER_RING_DEFAULT);
+    loadAlgorithms();
 
-    size_t sent_bytes = 0;
-    ssize_t wrote;
+    poolInit();
+    reduceInit();
+    for (int i = 0; i < world_size; i++) {
+        queueInit(&queues[i]);
+        world_comm.ranks[i] = i;
+    }
+}
 
-    while (sent_bytes < count) {
-        size_t to_send = (count - sent_bytes > BUFFER_SIZE) ? BUFFER_SIZE : 
-            (count - sent_bytes);
+/************************ FUNCTIONS FOR FINALIZE ************************/
+void destroyMutexes() {
+    for (int i = 0; i < world_size; i++) {
+        pthread_mutex_destroy(&mutex_list[i]);
+        pthread_mutex_destroy(&send_lock[i]);
+        pthread_cond_destroy(&flow[i].credit_cond);
+    }
 
-        wrote = tryToPointSendConst((40 * (destination + 1) + my_rank), 
-            data + sent_bytes, to_send);
+    pthread_mutex_destroy(&jobs_mutex);
+    pthread_cond_destroy(&jobs_cond);
 
-        if (wrote == -1) {
-            return MIMPI_ERROR_REMOTE_FINISHED;
-        }
+    pthread_mutex_destroy(&completions_mutex);
+    pthread_cond_destroy(&completions_cond);
 
-        sent_bytes += wrote;
-        
-    }
+    pthread_mutex_destroy(&collectives_mutex);
+    pthread_cond_destroy(&collectives_cond);
 
-    if (tryToPointSend((40 * (destination + 1) + my_rank), 
-        &tag, sizeof(tag)) == -1) {
-        return MIMPI_ERROR_REMOTE_FINISHED;
+    pthread_mutex_destroy(&deadlock_mutex);
+}
+
+/*
+    Lets the writer drain its queue, flushed detached sends included, while
+    the engine keeps reading, so that peers doing the same never block on
+    a full pipe.
+*/
+void stopWriter() {
+    ASSERT_ZERO(pthread_mutex_lock(&jobs_mutex));
+    writer_stop = true;
+    ASSERT_ZERO(pthread_cond_signal(&jobs_cond));
+    ASSERT_ZERO(pthread_mutex_unlock(&jobs_mutex));
+    ASSERT_ZERO(pthread_join(writer, NULL));
+}
+
+/* The engine returns once every peer has closed its writing end. */
+void stopProgressEngine() {
+    ASSERT_ZERO(pthread_join(engine, NULL));
+    ASSERT_SYS_OK(close(engine_epoll));
+
+    for (int i = 0; i < world_size; i++) {
+        poolFree(states[i] -> node);
+        free(states[i]);
     }
+    free(states);
+}
 
-    return MIMPI_SUCCESS;
+static void closeTableEntry(int* fd) {
+    if (*fd != -1) {
+        close(*fd);
+        *fd = -1;
+    }
 }
 
-void createReaders() {
+void closeReadingPointToPointPipes() {
     for (int i = 0; i < world_size; i++) {
         if (i != my_rank) {
-            int* j = malloc(sizeof(int));
-            *j = i;
-            ASSERT_ZERO(pthread_create(&readers[i], NULL, Reader, (void*) j));
+            closeTableEntry(&FD_IN(&fds, i));
         }
     }
 }
 
-/************************ GROUP FUNCTIONS ************************/
-// SENDER AND RECEIVER
-static MIMPI_Retcode GroupSend(int fd, void* data, int count) {
-    size_t sent_bytes = 0;
-    ssize_t wrote;
-
-    while (sent_bytes < count) {
-        size_t to_send = (count - sent_bytes > BUFFER_SIZE) ? BUFFER_SIZE : 
-            (count - sent_bytes);
+void closeWritingPointToPointPipes() {
+    for (int i = 0; i < world_size; i++) {
+        if (i != my_rank) {
+            closeTableEntry(&FD_OUT(&fds, i));
+        }
+    }
+}
 
-        wrote = tryToGroupSend(fd, data + sent_bytes, to_send);
+void closeGroupPipes() {
+    closeTableEntry(&FD_PARENT_IN(&fds));
+    closeTableEntry(&FD_PARENT_OUT(&fds));
 
-        if (wrote == -1) {
-            return MIMPI_ERROR_REMOTE_FINISHED;
-        }
+    for (int i = 0; i < 2; i++) {
+        closeTableEntry(&FD_CHILD_IN(&fds, i));
+        closeTableEntry(&FD_CHILD_OUT(&fds, i));
+    }
+}
 
-        sent_bytes += wrote; 
+void cleanListsAndVariables() {
+    for (int i = 0; i < world_size; i++) {
+        queueFree(&queues[i]);
     }
 
-    return MIMPI_SUCCESS;
+    free(queues);
+    poolDestroy();
+    tuningFree();
+    free(posted);
+    free(awaiting);
+    free(rendezvous);
+    free(send_seq);
+    free(mutex_list);
+    free(send_lock);
+    free(flow);
+    free(world_comm.ranks);
+    free(world_comm.trees);
+    free(sent_messages);
+    free(received_messages);
+    free(has_finished);
+    transportFinalize();
+    fdTableFree(&fds);
 }
 
-static MIMPI_Retcode GroupRecv(int fd, void* data, int count) {
-    size_t read_bytes = 0;
-    ssize_t read = 0;
+/************************ POINT TO POINT FUNCTIONS ************************/
+static bool matches(posted_recv* request, int count, int tag, int context) {
+    return request -> count == count && request -> context == context && 
+        (request -> tag == tag || (request -> tag == MIMPI_ANY_TAG && tag > 0));
+}
 
-    while (read_bytes < count) {
-        size_t to_read = (count - read_bytes > BUFFER_SIZE) ? BUFFER_SIZE :
-            (count - read_bytes);
+/* Unlinks and returns the earliest receive posted for a matching message. */
+static posted_recv* takePosted(int source, int count, int tag, int context) {
+    posted_recv** link = &posted[source];
+    while (*link != NULL && !matches(*link, count, tag, context)) {
+        link = &(*link) -> next;
+    }
 
-        read = tryToGroupReceive(fd, data + read_bytes, to_read);
+    posted_recv* found = *link;
+    if (found != NULL) {
+        *link = found -> next;
+    }
+    return found;
+}
 
-        if (read == -1) {
-            return MIMPI_ERROR_REMOTE_FINISHED;
-        }
+static void removePosted(posted_recv** list, posted_recv* request) {
+    posted_recv** link = list;
+    while (*link != NULL && *link != request) {
+        link = &(*link) -> next;
+    }
 
-        read_bytes += read;
+    if (*link != NULL) {
+        *link = request -> next;
     }
+}
 
-    return MIMPI_SUCCESS;
+static void notifyCompletion() {
+    ASSERT_ZERO(pthread_mutex_lock(&completions_mutex));
+    completions++;
+    ASSERT_ZERO(pthread_cond_broadcast(&completions_cond));
+    ASSERT_ZERO(pthread_mutex_unlock(&completions_mutex));
 }
 
+static void finishPosted(posted_recv* request) {
+    request -> done = true;
+    ASSERT_ZERO(pthread_cond_signal(&request -> cond));
+    notifyCompletion();
+}
 
+static void releaseDetached(rendezvous_send* send) {
+    atomic_fetch_sub(&detached_bytes, (size_t) send -> count);
+    ASSERT_ZERO(pthread_cond_destroy(&send -> cond));
+    poolFree(send);
+}
 
-// HELPER FUNCTIONS
+static void readerCleanup(int readingFrom) {
+    reader_state* state = states[readingFrom];
 
-static u_int8_t* reducer(void* tab1, const void* tab2, int count, MIMPI_Op op) {
-    u_int8_t* res_tab = malloc(count);
-    u_int8_t one = *(u_int8_t*) tab1;
-    u_int8_t two = *(u_int8_t*) tab2;
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[readingFrom]));
+    has_finished[readingFrom] = true;
 
-    switch (op) {
-    case MIMPI_MAX:
-        for (int i = 0; i < count; i++) {
-            one = *(u_int8_t*) tab1;
-            two = *(u_int8_t*) tab2;
-            if (one > two) {
-                res_tab[i] = one;
-            }
-            else {
-                res_tab[i] = two;
-            }
-            tab1++;
-            tab2++;
+    for (posted_recv* request = posted[readingFrom]; request != NULL; 
+        request = request -> next) {
+        ASSERT_ZERO(pthread_cond_signal(&request -> cond));
+    }
+    for (posted_recv* request = awaiting[readingFrom]; request != NULL; 
+        request = request -> next) {
+        ASSERT_ZERO(pthread_cond_signal(&request -> cond));
+    }
+    // Neither do sends waiting for credit get any.
+    ASSERT_ZERO(pthread_cond_broadcast(&flow[readingFrom].credit_cond));
+    // Sends not cleared yet never will be.
+    rendezvous_send** link = &rendezvous[readingFrom];
+    while (*link != NULL) {
+        rendezvous_send* send = *link;
+        if (send -> detached) {
+            *link = send -> next;
+            releaseDetached(send);
         }
-        break;
-    
-    case MIMPI_MIN:
-        for (int i = 0; i < count; i++) {
-            one = *(u_int8_t*) tab1;
-            two = *(u_int8_t*) tab2;
-
-            if (one < two) {
-                res_tab[i] = one;
-            }
+        else {
+            ASSERT_ZERO(pthread_cond_signal(&send -> cond));
+            link = &send -> next;
+        }
+    }
+
+    if (state -> posted != NULL) {
+        ASSERT_ZERO(pthread_cond_signal(&state -> posted -> cond));
+        state -> posted = NULL;
+    }
+    poolFree(state -> node);
+    state -> node = NULL;
+    state -> buf = NULL;
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[readingFrom]));
+
+    notifyCompletion();
+}
+
+/************************ PROGRESS ENGINE ************************/
+static void queueJob(writer_job* job) {
+    job -> next = NULL;
+
+    ASSERT_ZERO(pthread_mutex_lock(&jobs_mutex));
+    if (writer_stop) {
+        // Finalize has joined the writer; peers are about to see EOF anyway.
+        ASSERT_ZERO(pthread_mutex_unlock(&jobs_mutex));
+        if (job -> kind == JOB_PROBE) {
+            poolFree(job -> probe);
+        }
+        poolFree(job);
+        return;
+    }
+    if (jobs_tail == NULL) {
+        jobs_head = job;
+    }
+    else {
+        jobs_tail -> next = job;
+    }
+    jobs_tail = job;
+    ASSERT_ZERO(pthread_cond_signal(&jobs_cond));
+    ASSERT_ZERO(pthread_mutex_unlock(&jobs_mutex));
+}
+
+/* Hands a write over to the writer thread. */
+static void scheduleWrite(writer_job_kind kind, int peer, uint32_t id, 
+    rendezvous_send* send) {
+    writer_job* job = poolAlloc(sizeof(writer_job));
+    job -> kind = kind;
+    job -> peer = peer;
+    job -> id = id;
+    job -> send = send;
+    queueJob(job);
+}
+
+static size_t probeSize(uint32_t hops) {
+    return sizeof(deadlock_probe) + hops * sizeof(wait_hop);
+}
+
+/* Sends a probe along the path of another one, extended by a hop if given. */
+static void scheduleProbe(int peer, uint8_t kind, uint32_t received, 
+    const deadlock_probe* along, const wait_hop* hop) {
+    uint32_t hops = (along != NULL ? along -> hops : 0) + (hop != NULL);
+    deadlock_probe* probe = poolAlloc(probeSize(hops));
+    probe -> kind = kind;
+    probe -> received = received;
+    probe -> hops = hops;
+    if (along != NULL) {
+        memcpy(probe -> path, along -> path, along -> hops * sizeof(wait_hop));
+    }
+    if (hop != NULL) {
+        probe -> path[hops - 1] = *hop;
+    }
+
+    writer_job* job = poolAlloc(sizeof(writer_job));
+    job -> kind = JOB_PROBE;
+    job -> peer = peer;
+    job -> probe = probe;
+    queueJob(job);
+}
+
+/*
+    Gives the budget of a consumed message back to its source, in batches
+    to keep credit frames rare. Must be called with mutex_list[source] held.
+*/
+static void returnCredit(int source, size_t charge) {
+    flow[source].unreturned += charge;
+    if (flow[source].unreturned >= credit_batch) {
+        scheduleWrite(JOB_CREDIT, source, flow[source].unreturned, NULL);
+        flow[source].unreturned = 0;
+    }
+}
+
+static void receiveCredit(int source, size_t bytes) {
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[source]));
+    flow[source].credit += bytes;
+    flow[source].credit_returns++;
+    ASSERT_ZERO(pthread_cond_broadcast(&flow[source].credit_cond));
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[source]));
+}
+
+/*
+    Moves a receive matched with an announced message to the awaiting list
+    and clears its sender to transfer the payload. Must be called with
+    mutex_list[source] held.
+*/
+static void clearAnnounced(posted_recv* request, int source, uint32_t id) {
+    request -> rendezvous_id = id;
+    request -> next = awaiting[source];
+    awaiting[source] = request;
+    scheduleWrite(JOB_CLEAR, source, id, NULL);
+}
+
+static posted_recv* takeAwaiting(int source, uint32_t id) {
+    posted_recv** link = &awaiting[source];
+    while (*link != NULL && (*link) -> rendezvous_id != id) {
+        link = &(*link) -> next;
+    }
+
+    posted_recv* found = *link;
+    if (found != NULL) {
+        *link = found -> next;
+    }
+    return found;
+}
+
+/*
+    An announced message either meets a posted receive, which is cleared
+    at once, or waits in the unexpected queue as a node without payload.
+*/
+static void receiveAnnouncement(int source, frame_header* header) {
+    TRACE(TRACE_ANNOUNCEMENT, TRACE_INSTANT, source, header -> tag, 
+        header -> length, 0);
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[source]));
+    received_messages[source]++;
+    posted_recv* request = takePosted(source, header -> length, header -> tag, 
+        header -> context);
+
+    if (request != NULL) {
+        returnCredit(source, announcementCharge());
+        clearAnnounced(request, source, header -> seq);
+    }
+    else {
+        messages_node* node = poolAlloc(sizeof(messages_node));
+        node -> message.data = NULL;
+        node -> message.count = header -> length;
+        node -> message.source = source;
+        node -> message.tag = header -> tag;
+        node -> message.context = header -> context;
+        node -> message.announced = true;
+        node -> message.rendezvous_id = header -> seq;
+        queuePush(&queues[source], node);
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[source]));
+}
+
+static void receiveClearance(int source, uint32_t id) {
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[source]));
+    rendezvous_send** link = &rendezvous[source];
+    while (*link != NULL && (*link) -> id != id) {
+        link = &(*link) -> next;
+    }
+
+    // A detached send flushed in MIMPI_Finalize is not on the list anymore.
+    rendezvous_send* send = *link;
+    if (send != NULL) {
+        *link = send -> next;
+        send -> cleared = true;
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[source]));
+
+    if (send != NULL) {
+        scheduleWrite(JOB_PAYLOAD, source, id, send);
+    }
+}
+
+/*
+    Locks mutex_list of the source the blocking receive waits for and then
+    deadlock_mutex. Returns the source, or -1 with nothing locked if no
+    receive is blocked.
+*/
+static int lockWaiting() {
+    while (true) {
+        ASSERT_ZERO(pthread_mutex_lock(&deadlock_mutex));
+        bool blocked = waiting.blocked;
+        int source = waiting.source;
+        ASSERT_ZERO(pthread_mutex_unlock(&deadlock_mutex));
+        if (!blocked) {
+            return -1;
+        }
+
+        ASSERT_ZERO(pthread_mutex_lock(&mutex_list[source]));
+        ASSERT_ZERO(pthread_mutex_lock(&deadlock_mutex));
+        if (waiting.blocked && waiting.source == source) {
+            return source;
+        }
+        ASSERT_ZERO(pthread_mutex_unlock(&deadlock_mutex));
+        ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[source]));
+    }
+}
+
+/*
+    Whether the blocking receive still waits for a message nothing received
+    so far matches. Must be called with the locks of lockWaiting held.
+*/
+static bool stillBlocked() {
+    if (!waiting.blocked || waiting.deadlocked || 
+        has_finished[waiting.source]) {
+        return false;
+    }
+
+    for (posted_recv* request = posted[waiting.source]; request != NULL; 
+        request = request -> next) {
+        if (request == waiting.request) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Ends the blocking receive with MIMPI_ERROR_DEADLOCK_DETECTED. */
+static void declareDeadlock() {
+    waiting.deadlocked = true;
+    ASSERT_ZERO(pthread_cond_signal(&waiting.request -> cond));
+}
+
+/* Position of the wait of this rank on the path of a probe, or -1. */
+static int hopOf(deadlock_probe* probe) {
+    for (uint32_t i = 0; i < probe -> hops; i++) {
+        if (probe -> path[i].rank == my_rank) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+    A wait probe from a rank blocked on this one is only valid if all
+    messages sent to it have arrived, since any of them could end its wait.
+    Probes stuck in a cycle the initiator is not part of die out.
+*/
+static void receiveWaitProbe(int source, deadlock_probe* probe) {
+    if (!stillBlocked() || 
+        atomic_load(&sent_messages[source]) != probe -> received) {
+        return;
+    }
+
+    int hop = hopOf(probe);
+    if (hop == 0 && probe -> path[0].epoch == waiting.epoch) {
+        scheduleProbe(source, PROBE_CONFIRM, 0, probe, NULL);
+    }
+    else if (hop == -1) {
+        wait_hop mine = {my_rank, waiting.epoch};
+        scheduleProbe(waiting.source, PROBE_WAIT, 
+            received_messages[waiting.source], probe, &mine);
+    }
+}
+
+/*
+    Confirmations and deadlock notices go back along the path, as long as
+    every rank on it still waits where it passed the probe on. A confirmation
+    back at the initiator turns into a notice.
+*/
+static void receiveBackwardProbe(deadlock_probe* probe) {
+    int hop = hopOf(probe);
+    if (hop == -1 || !stillBlocked() || 
+        probe -> path[hop].epoch != waiting.epoch) {
+        return;
+    }
+
+    uint8_t kind = probe -> kind;
+    if (kind == PROBE_CONFIRM && hop == 0) {
+        kind = PROBE_DEADLOCK;
+    }
+
+    int previous = probe -> path[(hop > 0) ? hop - 1 : probe -> hops - 1].rank;
+    if (kind == PROBE_DEADLOCK) {
+        // Counted before this wait ends, as what this rank sends next is.
+        atomic_fetch_add(&sent_messages[previous], 1);
+        declareDeadlock();
+    }
+    scheduleProbe(previous, kind, 0, probe, NULL);
+}
+
+static void receiveProbe(int source, deadlock_probe* probe, size_t length) {
+    if (length < sizeof(deadlock_probe) || 
+        length != probeSize(probe -> hops)) {
+        fatal("Malformed deadlock probe from rank %d", source);
+    }
+
+    if (probe -> kind == PROBE_DEADLOCK) {
+        ASSERT_ZERO(pthread_mutex_lock(&mutex_list[source]));
+        received_messages[source]++;
+        ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[source]));
+    }
+
+    int blocked_on = lockWaiting();
+    if (blocked_on == -1) {
+        return;
+    }
+
+    if (probe -> kind == PROBE_WAIT) {
+        receiveWaitProbe(source, probe);
+    }
+    else {
+        receiveBackwardProbe(probe);
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&deadlock_mutex));
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[blocked_on]));
+}
+
+/*
+    Chooses where the payload of a message whose header has just been
+    parsed goes: the buffer of a matching posted receive if there is one,
+    otherwise a single pool block holding the list node with the payload
+    stored inline right after it. Payload of an announced message goes to
+    its awaiting receive or, when it comes unsolicited, to a separate block.
+*/
+static void startMessage(int source, reader_state* state) {
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[source]));
+    if (state -> header.flags == FRAME_PAYLOAD) {
+        state -> posted = takeAwaiting(source, state -> header.tag);
+    }
+    else {
+        state -> posted = takePosted(source, state -> header.length, 
+            state -> header.tag, state -> header.context);
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[source]));
+
+    if (state -> posted != NULL) {
+        state -> node = NULL;
+        state -> buf = state -> posted -> data;
+    }
+    else if (state -> header.flags == FRAME_PAYLOAD) {
+        state -> node = NULL;
+        state -> buf = poolAlloc(state -> header.length);
+    }
+    else {
+        state -> node = poolAlloc(sizeof(messages_node) + state -> header.length);
+        state -> buf = state -> node + 1;
+    }
+    state -> got = 0;
+}
+
+static messages_node* findAnnounced(int source, uint32_t id) {
+    messages_node* node = queues[source].head;
+    while (node != NULL && 
+        !(node -> message.announced && node -> message.rendezvous_id == id)) {
+        node = node -> next;
+    }
+    return node;
+}
+
+static void completeMessage(int source, reader_state* state) {
+    if (state -> header.flags == FRAME_EAGER && 
+        state -> header.tag == TAG_DEADLOCK) {
+        receiveProbe(source, state -> buf, state -> header.length);
+        poolFree(state -> node);
+        state -> node = NULL;
+        state -> buf = NULL;
+        state -> got = 0;
+        state -> stage = READ_HEADER;
+        return;
+    }
+    TRACE(state -> header.flags == FRAME_EAGER ? TRACE_ARRIVAL : TRACE_PAYLOAD, 
+        TRACE_INSTANT, source, state -> header.tag, state -> header.length, 0);
+
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[source]));
+    if (state -> header.flags == FRAME_EAGER) {
+        received_messages[source]++;
+    }
+    if (state -> posted != NULL) {
+        if (state -> header.flags == FRAME_EAGER) {
+            returnCredit(source, chargeOf(state -> header.length));
+        }
+        finishPosted(state -> posted);
+    }
+    else if (state -> header.flags == FRAME_PAYLOAD) {
+        // The announcement was matched while the payload was arriving.
+        posted_recv* request = takeAwaiting(source, state -> header.tag);
+
+        if (request != NULL) {
+            memcpy(request -> data, state -> buf, state -> header.length);
+            poolFree(state -> buf);
+            finishPosted(request);
+        }
+        else {
+            messages_node* node = findAnnounced(source, state -> header.tag);
+            if (node == NULL) {
+                fatal("Rank %d sent payload of unknown message %u", 
+                    source, state -> header.tag);
+            }
+            node -> message.data = state -> buf;
+        }
+    }
+    else {
+        // A receive might have been posted while the payload was arriving.
+        posted_recv* request = takePosted(source, state -> header.length, 
+            state -> header.tag, state -> header.context);
+
+        if (request != NULL) {
+            memcpy(request -> data, state -> buf, state -> header.length);
+            poolFree(state -> node);
+            returnCredit(source, chargeOf(state -> header.length));
+            finishPosted(request);
+        }
+        else {
+            messages_node *new_node = state -> node;
+            new_node -> message.data = state -> buf;
+            new_node -> message.count = state -> header.length;
+            new_node -> message.source = source;
+            new_node -> message.tag = state -> header.tag;
+            new_node -> message.context = state -> header.context;
+            new_node -> message.announced = false;
+            queuePush(&queues[source], new_node);
+        }
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[source]));
+
+    state -> posted = NULL;
+    state -> node = NULL;
+    state -> buf = NULL;
+    state -> got = 0;
+    state -> stage = READ_HEADER;
+}
+
+/*
+    Consumes complete headers and the payload bytes that arrived with them
+    from the inbox of a source. Stops when the inbox no longer holds a whole
+    header or when the rest of a payload has to be read from the pipe.
+*/
+static void parseInbox(int source) {
+    reader_state* state = states[source];
+    size_t parsed = 0;
+
+    while (state -> stage == READ_HEADER && 
+        state -> inbox_len - parsed >= sizeof(frame_header)) {
+        memcpy(&state -> header, state -> inbox + parsed, sizeof(frame_header));
+        parsed += sizeof(frame_header);
+
+        if (state -> header.version != FRAME_VERSION ||
+            state -> header.seq != state -> expected_seq) {
+            fatal("Malformed frame from rank %d (version %d, seq %u)", 
+                source, state -> header.version, state -> header.seq);
+        }
+        state -> expected_seq++;
+
+        if (state -> header.flags == FRAME_ANNOUNCE) {
+            receiveAnnouncement(source, &state -> header);
+            continue;
+        }
+        if (state -> header.flags == FRAME_CLEAR) {
+            receiveClearance(source, state -> header.tag);
+            continue;
+        }
+        if (state -> header.flags == FRAME_CREDIT) {
+            receiveCredit(source, state -> header.length);
+            continue;
+        }
+
+        size_t length = state -> header.length;
+        size_t ready = state -> inbox_len - parsed;
+        size_t taken = (length > ready) ? ready : length;
+
+        startMessage(source, state);
+        memcpy(state -> buf, state -> inbox + parsed, taken);
+        parsed += taken;
+        state -> got = taken;
+
+        if (taken == length) {
+            completeMessage(source, state);
+        }
+        else {
+            state -> stage = READ_PAYLOAD;
+        }
+    }
+
+    memmove(state -> inbox, state -> inbox + parsed, state -> inbox_len - parsed);
+    state -> inbox_len -= parsed;
+}
+
+/*
+    Performs a single read from a given source and advances its reassembly
+    state. Reads never wait for more data than the pipe reported as ready
+    (or the transport announced), so one slow sender can not stall the others.
+    Headers are read into the inbox of the source together with whatever
+    follows them, the rest of a payload goes straight to its buffer.
+    Returns false once the source has closed its end.
+*/
+static bool progressSource(int source) {
+    reader_state* state = states[source];
+    ssize_t read;
+
+    if (state -> stage == READ_HEADER) {
+        read = tryToPointReceive(source, 
+            state -> inbox + state -> inbox_len, 
+            BUFFER_SIZE - state -> inbox_len);
+        if (read == -1) {
+            return false;
+        }
+
+        state -> inbox_len += read;
+        parseInbox(source);
+        return true;
+    }
+
+    size_t left = state -> header.length - state -> got;
+    read = tryToPointReceive(source, state -> buf + state -> got, left);
+    if (read == -1) {
+        return false;
+    }
+
+    state -> got += read;
+    if (state -> got == state -> header.length) {
+        completeMessage(source, state);
+    }
+
+    return true;
+}
+
+static void* ProgressEngine(void* _args) {
+    struct epoll_event events[ENGINE_EVENTS];
+    traceThread("progress engine");
+    int open_sources = world_size - 1;
+
+    while (open_sources > 0) {
+        int ready = epoll_wait(engine_epoll, events, ENGINE_EVENTS, -1);
+        if (ready == -1 && errno == EINTR) {
+            continue;
+        }
+        ASSERT_SYS_OK(ready);
+
+        for (int i = 0; i < ready; i++) {
+            int source = events[i].data.u32;
+
+            bool open;
+            do {
+                open = progressSource(source);
+            } while (open && transportPending(source));
+
+            if (!open) {
+                ASSERT_SYS_OK(epoll_ctl(engine_epoll, EPOLL_CTL_DEL, 
+                    FD_IN(&fds, source), NULL));
+                readerCleanup(source);
+                open_sources--;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+    Either satisfies a receive from the unexpected-message queue or appends
+    it to the posted queue of its source. Must be called with 
+    mutex_list[source] held. Returns true if the receive has completed
+    (successfully or not) and result holds its outcome.
+*/
+static bool postReceive(posted_recv* request, int source, 
+    MIMPI_Retcode* result) {
+    messages_node *temp = queueFind(&queues[source], request -> count, 
+        request -> tag, request -> context);
+
+    if (temp != NULL && temp -> message.data != NULL) {
+        memcpy(request -> data, temp -> message.data, request -> count);
+        if (temp -> message.announced) {
+            poolFree(temp -> message.data);
+            returnCredit(source, announcementCharge());
+        }
+        else {
+            returnCredit(source, chargeOf(request -> count));
+        }
+        queueRemove(&queues[source], temp);
+        poolFree(temp);
+        request -> done = true;
+        *result = MIMPI_SUCCESS;
+        return true;
+    }
+
+    if (has_finished[source]) {
+        *result = MIMPI_ERROR_REMOTE_FINISHED;
+        return true;
+    }
+
+    request -> done = false;
+    request -> next = NULL;
+    ASSERT_ZERO(pthread_cond_init(&request -> cond, NULL));
+
+    if (temp != NULL) {
+        uint32_t id = temp -> message.rendezvous_id;
+        queueRemove(&queues[source], temp);
+        poolFree(temp);
+        returnCredit(source, announcementCharge());
+        clearAnnounced(request, source, id);
+        return false;
+    }
+
+    posted_recv** link = &posted[source];
+    while (*link != NULL) {
+        link = &(*link) -> next;
+    }
+    *link = request;
+
+    return false;
+}
+
+/* Settles a posted receive once it is done or its source has finished. */
+static MIMPI_Retcode settleReceive(posted_recv* request, int source) {
+    if (!request -> done) {
+        removePosted(&posted[source], request);
+        removePosted(&awaiting[source], request);
+    }
+    ASSERT_ZERO(pthread_cond_destroy(&request -> cond));
+
+    return request -> done ? MIMPI_SUCCESS : MIMPI_ERROR_REMOTE_FINISHED;
+}
+
+static struct timespec deadlineAfter(int milliseconds) {
+    struct timespec deadline;
+    ASSERT_SYS_OK(clock_gettime(CLOCK_REALTIME, &deadline));
+    deadline.tv_sec += milliseconds / 1000;
+    deadline.tv_nsec += (milliseconds % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return deadline;
+}
+
+/*
+    Makes a receive the blocking one of this rank, unless another is, and
+    sends a wait probe to its source while nothing received matches it.
+    Must be called with mutex_list[source] held.
+*/
+static void probeSource(posted_recv* request, int source, bool* registered) {
+    ASSERT_ZERO(pthread_mutex_lock(&deadlock_mutex));
+    if (!*registered && !waiting.blocked) {
+        waiting = (wait_state) {
+            .blocked = true,
+            .deadlocked = false,
+            .source = source,
+            .epoch = ++wait_epochs,
+            .request = request,
+        };
+        *registered = true;
+    }
+
+    if (*registered && stillBlocked()) {
+        wait_hop mine = {my_rank, waiting.epoch};
+        scheduleProbe(source, PROBE_WAIT, received_messages[source], NULL, 
+            &mine);
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&deadlock_mutex));
+}
+
+/*
+    Waits like waitForMessage, but a wait longer than deadlock_delay starts
+    deadlock detection. The probe is repeated, as ranks down the wait-for
+    edges may not have blocked yet, with pauses doubling up to
+    PROBE_INTERVAL_MAX, as a newer probe supersedes one still going around.
+    Receives that do not wait that long never send anything extra.
+*/
+static MIMPI_Retcode waitDetecting(posted_recv* request, int source) {
+    struct timespec deadline = deadlineAfter(deadlock_delay);
+    int interval = (deadlock_delay > 0) ? deadlock_delay : 1;
+    bool registered = false;
+    bool deadlocked = false;
+
+    while (!request -> done && !has_finished[source] && !deadlocked) {
+        int ret = pthread_cond_timedwait(&request -> cond, 
+            &mutex_list[source], &deadline);
+        if (ret == ETIMEDOUT) {
+            probeSource(request, source, &registered);
+            deadline = deadlineAfter(interval);
+            interval = (2 * interval < PROBE_INTERVAL_MAX) ? 
+                2 * interval : PROBE_INTERVAL_MAX;
+        }
+        else {
+            ASSERT_ZERO(ret);
+        }
+
+        if (registered) {
+            ASSERT_ZERO(pthread_mutex_lock(&deadlock_mutex));
+            deadlocked = waiting.deadlocked;
+            ASSERT_ZERO(pthread_mutex_unlock(&deadlock_mutex));
+        }
+    }
+
+    if (registered) {
+        ASSERT_ZERO(pthread_mutex_lock(&deadlock_mutex));
+        waiting.blocked = false;
+        ASSERT_ZERO(pthread_mutex_unlock(&deadlock_mutex));
+    }
+
+    MIMPI_Retcode ret = settleReceive(request, source);
+    return (deadlocked && !request -> done) ? 
+        MIMPI_ERROR_DEADLOCK_DETECTED : ret;
+}
+
+static MIMPI_Retcode waitForMessage(posted_recv* request, int source, 
+    bool detect) {
+    if (detect) {
+        return waitDetecting(request, source);
+    }
+
+    while (!request -> done && !has_finished[source]) {
+        ASSERT_ZERO(pthread_cond_wait(&request -> cond, &mutex_list[source]));
+    }
+
+    return settleReceive(request, source);
+}
+
+// HELPERS
+static MIMPI_Retcode receive(void* data, int count, int source, int tag, 
+    int context, bool detect) {
+    posted_recv request = {
+        .data = data,
+        .count = count,
+        .tag = tag,
+        .context = context,
+    };
+    MIMPI_Retcode ret;
+
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[source]));
+    if (!postReceive(&request, source, &ret)) {
+        ret = waitForMessage(&request, source, detect);
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[source]));
+
+    return ret;
+}
+
+// EXTERN FUNCTIONS
+
+MIMPI_Retcode Recv(void* data, int count, int source, int tag, 
+    MIMPI_Comm comm) {
+    return receive(data, count, comm -> ranks[source], tag, comm -> context, 
+        deadlocks);
+}
+
+/*
+    Writes a single frame: its header and count bytes of data (fewer than
+    length for an announcement). Must be called with send_lock[destination]
+    held, which also keeps the seq numbers of a destination in order.
+*/
+static MIMPI_Retcode writeFrame(int destination, uint8_t kind, int32_t tag, 
+    int context, uint32_t length, const void* data, size_t count) {
+    char frame[BUFFER_SIZE];
+    frame_header header = {
+        .version = FRAME_VERSION,
+        .flags = kind,
+        .context = context,
+        .tag = tag,
+        .length = length,
+        .seq = send_seq[destination]++,
+    };
+
+    if ((kind == FRAME_EAGER || kind == FRAME_ANNOUNCE) && 
+        tag != TAG_DEADLOCK) {
+        atomic_fetch_add(&sent_messages[destination], 1);
+    }
+
+    size_t sent_bytes = (count > FIRST_CHUNK_SIZE) ? FIRST_CHUNK_SIZE : count;
+    size_t frame_size = sizeof(header) + sent_bytes;
+    memcpy(frame, &header, sizeof(header));
+    memcpy(frame + sizeof(header), data, sent_bytes);
+
+    ssize_t wrote;
+
+    // The transport may take only a part of the frame (a nearly full ring).
+    for (size_t framed = 0; framed < frame_size; framed += wrote) {
+        wrote = tryToPointSend(destination, 
+            frame + framed, frame_size - framed);
+        if (wrote == -1) {
+            return MIMPI_ERROR_REMOTE_FINISHED;
+        }
+    }
+
+    while (sent_bytes < count) {
+        wrote = tryToPointSend(destination, 
+            data + sent_bytes, count - sent_bytes);
+
+        if (wrote == -1) {
+            return MIMPI_ERROR_REMOTE_FINISHED;
+        }
+
+        sent_bytes += wrote;
+    }
+
+    return MIMPI_SUCCESS;
+}
+
+/*
+    Takes the budget of an announcement, waiting for the destination to
+    return some if there is not enough. Returns false if the destination
+    finishes first. Must be called with mutex_list[destination] held, and
+    without send_lock[destination], which the writer needs to return
+    credit the destination may be waiting for in turn.
+*/
+static bool waitForCredit(int destination) {
+    flow_state* state = &flow[destination];
+    while (state -> credit < announcementCharge()) {
+        if (has_finished[destination]) {
+            return false;
+        }
+        ASSERT_ZERO(pthread_cond_wait(&state -> credit_cond, 
+            &mutex_list[destination]));
+    }
+    state -> credit -= announcementCharge();
+
+    return true;
+}
+
+/*
+    Sends the announcement of a message above the eager threshold. The send
+    is registered first, as the clearance may come back at any moment.
+*/
+static MIMPI_Retcode announce(rendezvous_send* send, const void* data, 
+    int count, int destination, int tag, int context, bool detached) {
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[destination]));
+    bool granted = waitForCredit(destination);
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[destination]));
+    if (!granted) {
+        return MIMPI_ERROR_REMOTE_FINISHED;
+    }
+
+    send -> data = data;
+    send -> count = count;
+    send -> tag = tag;
+    send -> detached = detached;
+    send -> cleared = false;
+    send -> done = false;
+    send -> result = MIMPI_SUCCESS;
+    ASSERT_ZERO(pthread_cond_init(&send -> cond, NULL));
+
+    ASSERT_ZERO(pthread_mutex_lock(&send_lock[destination]));
+    send -> id = send_seq[destination];
+
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[destination]));
+    if (has_finished[destination]) {
+        ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[destination]));
+        ASSERT_ZERO(pthread_mutex_unlock(&send_lock[destination]));
+        ASSERT_ZERO(pthread_cond_destroy(&send -> cond));
+        return MIMPI_ERROR_REMOTE_FINISHED;
+    }
+    send -> next = rendezvous[destination];
+    rendezvous[destination] = send;
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[destination]));
+
+    MIMPI_Retcode ret = writeFrame(destination, FRAME_ANNOUNCE, tag, context, 
+        count, NULL, 0);
+    ASSERT_ZERO(pthread_mutex_unlock(&send_lock[destination]));
+
+    if (ret != MIMPI_SUCCESS) {
+        ASSERT_ZERO(pthread_mutex_lock(&mutex_list[destination]));
+        rendezvous_send** link = &rendezvous[destination];
+        while (*link != send) {
+            link = &(*link) -> next;
+        }
+        *link = send -> next;
+        ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[destination]));
+        ASSERT_ZERO(pthread_cond_destroy(&send -> cond));
+    }
+    return ret;
+}
+
+/* Must be called with mutex_list[destination] held. */
+static bool sendSettled(rendezvous_send* send, int destination) {
+    return send -> done || (!send -> cleared && has_finished[destination]);
+}
+
+/*
+    Settles an announced send once its payload is written or its destination
+    has finished before clearing it. Must be called with 
+    mutex_list[destination] held.
+*/
+static MIMPI_Retcode settleSend(rendezvous_send* send, int destination) {
+    if (!send -> done) {
+        rendezvous_send** link = &rendezvous[destination];
+        while (*link != send) {
+            link = &(*link) -> next;
+        }
+        *link = send -> next;
+        send -> result = MIMPI_ERROR_REMOTE_FINISHED;
+    }
+    ASSERT_ZERO(pthread_cond_destroy(&send -> cond));
+
+    return send -> result;
+}
+
+static MIMPI_Retcode waitForSend(rendezvous_send* send, int destination) {
+    while (!sendSettled(send, destination)) {
+        ASSERT_ZERO(pthread_cond_wait(&send -> cond, &mutex_list[destination]));
+    }
+
+    return settleSend(send, destination);
+}
+
+/* Takes budget for an eager message, or counts a stall if there is none. */
+static bool takeCredit(int destination, size_t count) {
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[destination]));
+    flow_state* state = &flow[destination];
+    bool granted = state -> credit >= chargeOf(count);
+    if (granted) {
+        state -> credit -= chargeOf(count);
+        state -> eager_sends++;
+    }
+    else {
+        state -> stalled_sends++;
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[destination]));
+
+    return granted;
+}
+
+/* Takes room for a copy of a detached send if detached_limit allows. */
+static bool reserveDetached(size_t count) {
+    size_t held = atomic_load(&detached_bytes);
+    do {
+        if (held + count > detached_limit) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak(&detached_bytes, &held, 
+        held + count));
+
+    return true;
+}
+
+/* Announces a message and waits until its payload is written. */
+static MIMPI_Retcode sendAndWait(const void* data, int count, 
+    int destination, int tag, int context) {
+    rendezvous_send send;
+    MIMPI_Retcode ret = announce(&send, data, count, destination, tag, 
+        context, false);
+    if (ret == MIMPI_SUCCESS) {
+        ASSERT_ZERO(pthread_mutex_lock(&mutex_list[destination]));
+        ret = waitForSend(&send, destination);
+        ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[destination]));
+    }
+    return ret;
+}
+
+/* Writes a message the destination has already granted credit for. */
+static MIMPI_Retcode sendEager(const void* data, int count, int destination, 
+    int tag, int context) {
+    // A finished destination keeps reading until every rank finishes, so
+    // writing to it would not fail.
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[destination]));
+    bool finished = has_finished[destination];
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[destination]));
+    if (finished) {
+        return MIMPI_ERROR_REMOTE_FINISHED;
+    }
+
+    ASSERT_ZERO(pthread_mutex_lock(&send_lock[destination]));
+    MIMPI_Retcode ret = writeFrame(destination, FRAME_EAGER, tag, context, 
+        count, data, count);
+    ASSERT_ZERO(pthread_mutex_unlock(&send_lock[destination]));
+
+    return ret;
+}
+
+/*
+    Messages up to the eager threshold go out at once and are buffered by
+    the destination if nobody waits for them, as long as the flow control
+    budget allows. Others are announced and transferred by the writer
+    thread once the destination posts a matching receive, so they never
+    take more than a list node there. MIMPI_Send should not wait for the
+    receive, so the payload waits in a copy held by the sender instead of
+    in the memory of the destination, unless such copies already take
+    detached_limit bytes.
+*/
+static MIMPI_Retcode sendMessage(const void* data, int count, int destination, 
+    int tag, int context) {
+    if (count > eager_threshold || !takeCredit(destination, count)) {
+        if (!reserveDetached(count)) {
+            return sendAndWait(data, count, destination, tag, context);
+        }
+        rendezvous_send* send = poolAlloc(sizeof(rendezvous_send) + count);
+        memcpy(send + 1, data, count);
+        MIMPI_Retcode ret = announce(send, send + 1, count, destination, tag, 
+            context, true);
+        if (ret != MIMPI_SUCCESS) {
+            atomic_fetch_sub(&detached_bytes, (size_t) count);
+            poolFree(send);
+        }
+        return ret;
+    }
+
+    return sendEager(data, count, destination, tag, context);
+}
+
+MIMPI_Retcode Send(const void* data, int count, int destination, int tag, 
+    MIMPI_Comm comm) {
+    return sendMessage(data, count, comm -> ranks[destination], tag, 
+        comm -> context);
+}
+
+static void writePayload(int destination, rendezvous_send* send) {
+    TRACE(TRACE_PAYLOAD, TRACE_BEGIN, destination, send -> id, send -> count, 
+        0);
+    ASSERT_ZERO(pthread_mutex_lock(&send_lock[destination]));
+    MIMPI_Retcode ret = writeFrame(destination, FRAME_PAYLOAD, send -> id, 
+        WORLD_CONTEXT, send -> count, send -> data, send -> count);
+    ASSERT_ZERO(pthread_mutex_unlock(&send_lock[destination]));
+    TRACE(TRACE_PAYLOAD, TRACE_END, destination, send -> id, send -> count, 
+        ret);
+
+    if (send -> detached) {
+        releaseDetached(send);
+        return;
+    }
+
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[destination]));
+    send -> result = ret;
+    send -> done = true;
+    ASSERT_ZERO(pthread_cond_signal(&send -> cond));
+    notifyCompletion();
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[destination]));
+}
+
+static void* Writer(void* _args) {
+    traceThread("writer");
+    while (true) {
+        ASSERT_ZERO(pthread_mutex_lock(&jobs_mutex));
+        while (jobs_head == NULL && !writer_stop) {
+            ASSERT_ZERO(pthread_cond_wait(&jobs_cond, &jobs_mutex));
+        }
+
+        writer_job* job = jobs_head;
+        if (job != NULL) {
+            jobs_head = job -> next;
+            if (jobs_head == NULL) {
+                jobs_tail = NULL;
+            }
+        }
+        ASSERT_ZERO(pthread_mutex_unlock(&jobs_mutex));
+
+        if (job == NULL) {
+            return NULL;
+        }
+
+        // A finished peer will never need a control frame, so failures
+        // to send one are ignored.
+        if (job -> kind == JOB_CLEAR) {
+            ASSERT_ZERO(pthread_mutex_lock(&send_lock[job -> peer]));
+            writeFrame(job -> peer, FRAME_CLEAR, job -> id, WORLD_CONTEXT, 0, 
+                NULL, 0);
+            ASSERT_ZERO(pthread_mutex_unlock(&send_lock[job -> peer]));
+        }
+        else if (job -> kind == JOB_CREDIT) {
+            ASSERT_ZERO(pthread_mutex_lock(&send_lock[job -> peer]));
+            writeFrame(job -> peer, FRAME_CREDIT, 0, WORLD_CONTEXT, job -> id, 
+                NULL, 0);
+            ASSERT_ZERO(pthread_mutex_unlock(&send_lock[job -> peer]));
+        }
+        else if (job -> kind == JOB_PROBE) {
+            // Probes take no flow control budget, they are consumed on arrival.
+            ASSERT_ZERO(pthread_mutex_lock(&send_lock[job -> peer]));
+            size_t length = probeSize(job -> probe -> hops);
+            writeFrame(job -> peer, FRAME_EAGER, TAG_DEADLOCK, WORLD_CONTEXT, 
+                length, job -> probe, length);
+            ASSERT_ZERO(pthread_mutex_unlock(&send_lock[job -> peer]));
+            poolFree(job -> probe);
+        }
+        else {
+            writePayload(job -> peer, job -> send);
+        }
+        poolFree(job);
+    }
+}
+
+/*
+    Detached sends that were never cleared go out unsolicited, so that their
+    destinations can still receive them after this rank is gone.
+*/
+void flushDetachedSends() {
+    for (int peer = 0; peer < world_size; peer++) {
+        ASSERT_ZERO(pthread_mutex_lock(&mutex_list[peer]));
+        rendezvous_send** link = &rendezvous[peer];
+        while (*link != NULL) {
+            rendezvous_send* send = *link;
+            if (send -> detached) {
+                *link = send -> next;
+                send -> cleared = true;
+                scheduleWrite(JOB_PAYLOAD, peer, send -> id, send);
+            }
             else {
-                res_tab[i] = two;
+                link = &send -> next;
+            }
+        }
+        ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[peer]));
+    }
+}
+
+void FlowStats(MIMPI_Flow_stats* stats) {
+    stats -> eager_sends = 0;
+    stats -> stalled_sends = 0;
+    stats -> credit_returns = 0;
+
+    for (int peer = 0; peer < world_size; peer++) {
+        ASSERT_ZERO(pthread_mutex_lock(&mutex_list[peer]));
+        stats -> eager_sends += flow[peer].eager_sends;
+        stats -> stalled_sends += flow[peer].stalled_sends;
+        stats -> credit_returns += flow[peer].credit_returns;
+        ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[peer]));
+    }
+}
+
+/* Prints the flow control counters if FLOW_REPORT_VAR asks for it. */
+void reportFlowStats() {
+    const char* value = getenv(FLOW_REPORT_VAR);
+    if (value == NULL || strcmp(value, "0") == 0) {
+        return;
+    }
+
+    MIMPI_Flow_stats stats;
+    FlowStats(&stats);
+    fprintf(stderr, "MIMPI rank %d: %llu eager sends, %llu stalled on budget "
+        "(sent by rendezvous), %llu credit returns\n", my_rank, 
+        stats.eager_sends, stats.stalled_sends, stats.credit_returns);
+}
+
+void PoolStats(MIMPI_Pool_stats* result) {
+    pool_stats stats;
+    poolStats(&stats);
+
+    *result = (MIMPI_Pool_stats) {
+        .large_allocs = stats.large.allocs,
+        .bytes_in_use = stats.bytes,
+        .peak_bytes = stats.peak_bytes,
+    };
+    for (int i = 0; i <= POOL_CLASSES; i++) {
+        pool_class_stats* counters = 
+            (i < POOL_CLASSES) ? &stats.classes[i] : &stats.large;
+        result -> allocs += counters -> allocs;
+        result -> frees += counters -> frees;
+        result -> in_use += counters -> in_use;
+        result -> slabs += counters -> slabs;
+    }
+}
+
+/*
+    Prints the counters of every block size of the pool if POOL_REPORT_VAR
+    asks for it. Blocks still in use belong to messages nobody received,
+    which the sweep in cleanListsAndVariables releases with the slabs.
+*/
+void reportPoolStats() {
+    const char* value = getenv(POOL_REPORT_VAR);
+    if (value == NULL || strcmp(value, "0") == 0) {
+        return;
+    }
+
+    pool_stats stats;
+    poolStats(&stats);
+    for (int i = 0; i <= POOL_CLASSES; i++) {
+        pool_class_stats* counters = 
+            (i < POOL_CLASSES) ? &stats.classes[i] : &stats.large;
+        if (counters -> allocs == 0) {
+            continue;
+        }
+        if (i < POOL_CLASSES) {
+            fprintf(stderr, "MIMPI rank %d: pool %zu B blocks: ", my_rank, 
+                counters -> block_size);
+        }
+        else {
+            fprintf(stderr, "MIMPI rank %d: pool large blocks: ", my_rank);
+        }
+        fprintf(stderr, "%llu allocs, %llu frees, peak %zu in use, "
+            "%zu slabs\n", (unsigned long long) counters -> allocs, 
+            (unsigned long long) counters -> frees, counters -> peak, 
+            counters -> slabs);
+    }
+
+    MIMPI_Pool_stats total;
+    PoolStats(&total);
+    fprintf(stderr, "MIMPI rank %d: pool sweep releases %llu blocks in use "
+        "and %llu slabs\n", my_rank, total.in_use, total.slabs);
+}
+
+static MIMPI_Request newRequest(request_kind kind, int peer) {
+    MIMPI_Request request = malloc(sizeof(struct MIMPI_Request_t));
+    if (request == NULL) {
+        fatal("Could not allocate a request");
+    }
+    request -> kind = kind;
+    request -> peer = peer;
+    request -> completed = false;
+    request -> result = MIMPI_SUCCESS;
+    return request;
+}
+
+/*
+    Eager sends the destination has credit for are handed to the channel
+    right away, so their request is complete as soon as it is created.
+    Others are announced like larger ones, without a copy, and complete
+    once the writer thread has transferred the payload.
+*/
+MIMPI_Retcode Isend(const void* data, int count, int destination, int tag, 
+    MIMPI_Comm comm, MIMPI_Request* request) {
+    destination = comm -> ranks[destination];
+    *request = newRequest(REQUEST_SEND, destination);
+
+    if (count <= eager_threshold && takeCredit(destination, count)) {
+        (*request) -> result = sendEager(data, count, destination, tag, 
+            comm -> context);
+        (*request) -> completed = true;
+    }
+    else {
+        (*request) -> result = announce(&(*request) -> send, data, count, 
+            destination, tag, comm -> context, false);
+        (*request) -> completed = ((*request) -> result != MIMPI_SUCCESS);
+    }
+
+    return MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode Irecv(void* data, int count, int source, int tag, 
+    MIMPI_Comm comm, MIMPI_Request* request) {
+    source = comm -> ranks[source];
+    MIMPI_Request new_request = newRequest(REQUEST_RECV, source);
+    new_request -> recv.data = data;
+    new_request -> recv.count = count;
+    new_request -> recv.tag = tag;
+    new_request -> recv.context = comm -> context;
+
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[source]));
+    new_request -> completed = postReceive(&new_request -> recv, source, 
+        &new_request -> result);
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[source]));
+
+    *request = new_request;
+    return MIMPI_SUCCESS;
+}
+
+/* Finishes a request if it can be finished without blocking. */
+static bool tryComplete(MIMPI_Request request) {
+    if (request -> completed) {
+        return true;
+    }
+
+    if (request -> kind == REQUEST_COLLECTIVE) {
+        ASSERT_ZERO(pthread_mutex_lock(&collectives_mutex));
+        request -> completed = request -> job.finished;
+        ASSERT_ZERO(pthread_mutex_unlock(&collectives_mutex));
+        return request -> completed;
+    }
+
+    int peer = request -> peer;
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[peer]));
+    if (request -> kind == REQUEST_SEND) {
+        if (sendSettled(&request -> send, peer)) {
+            request -> result = settleSend(&request -> send, peer);
+            request -> completed = true;
+        }
+    }
+    else if (request -> recv.done || has_finished[peer]) {
+        request -> result = settleReceive(&request -> recv, peer);
+        request -> completed = true;
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[peer]));
+
+    return request -> completed;
+}
+
+static MIMPI_Retcode releaseRequest(MIMPI_Request* request) {
+    MIMPI_Retcode result = (*request) -> result;
+    free(*request);
+    *request = MIMPI_REQUEST_NULL;
+    return result;
+}
+
+MIMPI_Retcode Wait(MIMPI_Request* request) {
+    if (*request == MIMPI_REQUEST_NULL) {
+        return MIMPI_SUCCESS;
+    }
+
+    if (!(*request) -> completed && 
+        (*request) -> kind == REQUEST_COLLECTIVE) {
+        ASSERT_ZERO(pthread_mutex_lock(&collectives_mutex));
+        while (!(*request) -> job.finished) {
+            ASSERT_ZERO(pthread_cond_wait(&collectives_cond, 
+                &collectives_mutex));
+        }
+        ASSERT_ZERO(pthread_mutex_unlock(&collectives_mutex));
+        (*request) -> completed = true;
+    }
+    else if (!(*request) -> completed) {
+        int peer = (*request) -> peer;
+        ASSERT_ZERO(pthread_mutex_lock(&mutex_list[peer]));
+        if ((*request) -> kind == REQUEST_SEND) {
+            (*request) -> result = waitForSend(&(*request) -> send, peer);
+        }
+        else {
+            (*request) -> result = waitForMessage(&(*request) -> recv, peer, 
+                deadlocks);
+        }
+        (*request) -> completed = true;
+        ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[peer]));
+    }
+
+    return releaseRequest(request);
+}
+
+MIMPI_Retcode Test(MIMPI_Request* request, bool* flag) {
+    if (*request == MIMPI_REQUEST_NULL) {
+        *flag = true;
+        return MIMPI_SUCCESS;
+    }
+
+    *flag = tryComplete(*request);
+    return *flag ? releaseRequest(request) : MIMPI_SUCCESS;
+}
+
+MIMPI_Retcode Waitall(int count, MIMPI_Request requests[]) {
+    MIMPI_Retcode result = MIMPI_SUCCESS;
+    for (int i = 0; i < count; i++) {
+        MIMPI_Retcode ret = Wait(&requests[i]);
+        if (result == MIMPI_SUCCESS) {
+            result = ret;
+        }
+    }
+    return result;
+}
+
+MIMPI_Retcode Waitany(int count, MIMPI_Request requests[], int* index) {
+    *index = -1;
+    while (true) {
+        ASSERT_ZERO(pthread_mutex_lock(&completions_mutex));
+        uint64_t seen = completions;
+        ASSERT_ZERO(pthread_mutex_unlock(&completions_mutex));
+
+        bool active = false;
+        for (int i = 0; i < count; i++) {
+            if (requests[i] != MIMPI_REQUEST_NULL) {
+                active = true;
+                if (tryComplete(requests[i])) {
+                    *index = i;
+                    return releaseRequest(&requests[i]);
+                }
+            }
+        }
+
+        if (!active) {
+            return MIMPI_SUCCESS;
+        }
+
+        ASSERT_ZERO(pthread_mutex_lock(&completions_mutex));
+        while (completions == seen) {
+            ASSERT_ZERO(pthread_cond_wait(&completions_cond, &completions_mutex));
+        }
+        ASSERT_ZERO(pthread_mutex_unlock(&completions_mutex));
+    }
+}
+
+/* Queues a collective for the collective thread behind those started before. */
+static void startCollective(collective_job job, MIMPI_Request* request) {
+    *request = newRequest(REQUEST_COLLECTIVE, -1);
+    (*request) -> job = job;
+    (*request) -> job.finished = false;
+    (*request) -> job.next = NULL;
+
+    ASSERT_ZERO(pthread_mutex_lock(&collectives_mutex));
+    if (collectives_tail != NULL) {
+        collectives_tail -> next = &(*request) -> job;
+    }
+    else {
+        collectives_head = &(*request) -> job;
+    }
+    collectives_tail = &(*request) -> job;
+    ASSERT_ZERO(pthread_cond_broadcast(&collectives_cond));
+    ASSERT_ZERO(pthread_mutex_unlock(&collectives_mutex));
+}
+
+void Ibarrier(MIMPI_Request* request) {
+    startCollective((collective_job) {
+        .kind = COLLECTIVE_BARRIER,
+        .comm = MIMPI_COMM_WORLD,
+    }, request);
+}
+
+void Ibcast(void* data, int count, int root, MIMPI_Request* request) {
+    startCollective((collective_job) {
+        .kind = COLLECTIVE_BCAST,
+        .comm = MIMPI_COMM_WORLD,
+        .data = data,
+        .count = count,
+        .root = root,
+    }, request);
+}
+
+void Ireduce(const void* send_data, void* recv_data, int count, MIMPI_Op op, 
+    int root, MIMPI_Request* request) {
+    startCollective((collective_job) {
+        .kind = COLLECTIVE_REDUCE,
+        .comm = MIMPI_COMM_WORLD,
+        .send_data = send_data,
+        .data = recv_data,
+        .count = count,
+        .op = op,
+        .root = root,
+    }, request);
+}
+
+/*
+    Moves a descriptor owned by the library right above the channel table,
+    keeping it out of the range reserved for user programs.
+*/
+static int moveAboveTable(int fd) {
+    int moved = fcntl(fd, F_DUPFD, FD_TABLE_BASE + fds_used);
+    ASSERT_SYS_OK(moved);
+    ASSERT_SYS_OK(close(fd));
+    return moved;
+}
+
+static MIMPI_Retcode runCollective(collective_job* job) {
+    switch (job -> kind) {
+    case COLLECTIVE_BARRIER:
+        return Barrier(job -> comm);
+
+    case COLLECTIVE_BCAST:
+        return Bcast(job -> data, job -> count, job -> root, job -> comm);
+
+    case COLLECTIVE_REDUCE:
+        return Reduce(job -> send_data, job -> data, job -> count, 
+            MIMPI_UINT8, job -> op, job -> root, job -> comm);
+
+    default:
+        fatal("Collective %d cannot run in the background", job -> kind);
+    }
+}
+
+static trace_kind tracedKind(collective_job* job) {
+    switch (job -> kind) {
+    case COLLECTIVE_BARRIER:
+        return TRACE_BARRIER;
+
+    case COLLECTIVE_BCAST:
+        return TRACE_BCAST;
+
+    default:
+        return TRACE_REDUCE;
+    }
+}
+
+static int tracedRoot(collective_job* job) {
+    return job -> kind == COLLECTIVE_BARRIER ? -1 : job -> root;
+}
+
+/*
+    Runs non-blocking collectives, so interior ranks of a tree forward data
+    even while their application threads are busy elsewhere.
+*/
+static void* CollectiveThread(void* arg) {
+    traceThread("collectives");
+    ASSERT_ZERO(pthread_mutex_lock(&collectives_mutex));
+    while (true) {
+        while (collectives_head == NULL && !collectives_stop) {
+            ASSERT_ZERO(pthread_cond_wait(&collectives_cond, 
+                &collectives_mutex));
+        }
+        if (collectives_head == NULL) {
+            break;
+        }
+
+        collective_job* job = collectives_head;
+        collectives_head = job -> next;
+        if (collectives_head == NULL) {
+            collectives_tail = NULL;
+        }
+        collective_running = true;
+        ASSERT_ZERO(pthread_mutex_unlock(&collectives_mutex));
+
+        TRACE(tracedKind(job), TRACE_BEGIN, tracedRoot(job), 0, job -> count, 
+            0);
+        MIMPI_Retcode ret = runCollective(job);
+        TRACE(tracedKind(job), TRACE_END, tracedRoot(job), 0, job -> count, 
+            ret);
+        MIMPI_Request request = (MIMPI_Request) 
+            ((char*) job - offsetof(struct MIMPI_Request_t, job));
+
+        ASSERT_ZERO(pthread_mutex_lock(&collectives_mutex));
+        request -> result = ret;
+        job -> finished = true;
+        collective_running = false;
+        ASSERT_ZERO(pthread_cond_broadcast(&collectives_cond));
+        ASSERT_ZERO(pthread_mutex_unlock(&collectives_mutex));
+        notifyCompletion();
+        ASSERT_ZERO(pthread_mutex_lock(&collectives_mutex));
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&collectives_mutex));
+
+    return NULL;
+}
+
+void waitForCollectives() {
+    ASSERT_ZERO(pthread_mutex_lock(&collectives_mutex));
+    while (collectives_head != NULL || collective_running) {
+        ASSERT_ZERO(pthread_cond_wait(&collectives_cond, &collectives_mutex));
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&collectives_mutex));
+}
+
+void stopCollectives() {
+    ASSERT_ZERO(pthread_mutex_lock(&collectives_mutex));
+    collectives_stop = true;
+    ASSERT_ZERO(pthread_cond_broadcast(&collectives_cond));
+    ASSERT_ZERO(pthread_mutex_unlock(&collectives_mutex));
+    ASSERT_ZERO(pthread_join(collective_thread, NULL));
+}
+
+void startProgressEngine() {
+    states = malloc(world_size * sizeof(reader_state*));
+    if (states == NULL) {
+        fatal("Could not allocate reader states for %d ranks", world_size);
+    }
+    for (int i = 0; i < world_size; i++) {
+        states[i] = calloc(1, sizeof(reader_state) + BUFFER_SIZE);
+        if (states[i] == NULL) {
+            fatal("Could not allocate reader state for rank %d", i);
+        }
+    }
+
+    engine_epoll = epoll_create1(0);
+    ASSERT_SYS_OK(engine_epoll);
+    engine_epoll = moveAboveTable(engine_epoll);
+
+    struct epoll_event event = { .events = EPOLLIN };
+    for (int i = 0; i < world_size; i++) {
+        if (i != my_rank) {
+            event.data.u32 = i;
+            ASSERT_SYS_OK(epoll_ctl(engine_epoll, EPOLL_CTL_ADD, 
+                FD_IN(&fds, i), &event));
+        }
+    }
+
+    ASSERT_ZERO(pthread_create(&engine, NULL, ProgressEngine, NULL));
+    ASSERT_ZERO(pthread_create(&writer, NULL, Writer, NULL));
+    ASSERT_ZERO(pthread_create(&collective_thread, NULL, CollectiveThread, 
+        NULL));
+}
+
+/************************ GROUP FUNCTIONS ************************/
+// SENDER AND RECEIVER
+/* Receives a message of a collective, which never counts as a deadlock. */
+static MIMPI_Retcode Search(void* data, int count, int source, int tag, 
+    MIMPI_Comm comm) {
+    return receive(data, count, comm -> ranks[source], tag, comm -> context, 
+        false);
+}
+
+/*
+    Sends a message of a collective. Unlike MIMPI_Send it waits for the
+    receive above the eager threshold instead of copying the data, which
+    is fine as every rank is bound to receive it in the same collective.
+*/
+static MIMPI_Retcode TreeSend(void* data, int count, int destination, 
+    int tag, MIMPI_Comm comm) {
+    if (count <= eager_threshold) {
+        return Send(data, count, destination, tag, comm);
+    }
+
+    return sendAndWait(data, count, comm -> ranks[destination], tag, 
+        comm -> context);
+}
+
+/*
+    Sends to one rank while receiving from another, as in every step of
+    Allreduce. Messages above the eager threshold are announced before the
+    receive and waited for after it, so both sides of an exchange can send
+    at once without copying their data.
+*/
+static MIMPI_Retcode Exchange(const void* send_data, int send_count, 
+    int destination, void* recv_data, int recv_count, int source, int tag, 
+    MIMPI_Comm comm) {
+    MIMPI_Retcode ret;
+
+    if (send_count <= eager_threshold) {
+        ret = Send(send_data, send_count, destination, tag, comm);
+        if (ret == MIMPI_SUCCESS) {
+            ret = Search(recv_data, recv_count, source, tag, comm);
+        }
+        return ret;
+    }
+
+    int peer = comm -> ranks[destination];
+    rendezvous_send send;
+    ret = announce(&send, send_data, send_count, peer, tag, comm -> context, 
+        false);
+    if (ret != MIMPI_SUCCESS) {
+        return ret;
+    }
+
+    ret = Search(recv_data, recv_count, source, tag, comm);
+
+    ASSERT_ZERO(pthread_mutex_lock(&mutex_list[peer]));
+    MIMPI_Retcode sent = waitForSend(&send, peer);
+    ASSERT_ZERO(pthread_mutex_unlock(&mutex_list[peer]));
+
+    return (ret != MIMPI_SUCCESS) ? ret : sent;
+}
+
+// HELPER FUNCTIONS
+
+/*
+    Picks the algorithm of a call: the pinned one, else the one of the first
+    rule of the tuning table that applies, else fallback. Each of them is
+    the same on every rank for the same call.
+*/
+static int chooseAlgorithm(collective_kind collective, long long bytes, 
+    int fallback, MIMPI_Comm comm) {
+    if (forced[collective] != -1) {
+        return forced[collective];
+    }
+
+    const char* name = tuningLookup(registry[collective].name, comm -> size, 
+        bytes);
+    return (name != NULL) ? algorithmIndex(collective, name) : fallback;
+}
+
+/*
+    In the binomial tree over ranks rotated so that the root is 0, rank v
+    has children v + 1, v + 2, v + 4, ... below the lowest set bit of v,
+    which this returns (or the first power of two not below the size of the
+    communicator for the root). The subtree of v spans the ranks v to
+    v + span - 1.
+*/
+static int binomialSpan(int me, MIMPI_Comm comm) {
+    int span = 1;
+    while (span < comm -> size && (me & span) == 0) {
+        span *= 2;
+    }
+    return span;
+}
+
+static const tree_topology* treeOf(int root, MIMPI_Comm comm) {
+    tree_topology* tree = &comm -> trees[root];
+    if (tree -> ready) {
+        return tree;
+    }
+
+    int me = (comm -> rank - root + comm -> size) % comm -> size;
+    tree -> parent = (me == 0) ? -1 : 
+        (TREE_PARENT(me) + root) % comm -> size;
+    tree -> child_count = 0;
+    for (int i = 0; i < 2; i++) {
+        if (TREE_CHILD(me, i) < comm -> size) {
+            tree -> children[tree -> child_count++] = 
+                (TREE_CHILD(me, i) + root) % comm -> size;
+        }
+    }
+    tree -> ready = true;
+
+    return tree;
+}
+
+/*
+    Ranks report up the heap tree to rank 0 over the group pipes and are
+    released down it, which takes 2 * ceil(log2(n + 1) - 1) latencies.
+*/
+static MIMPI_Retcode treeBarrier(void) {
+    int to_send = 3;
+    int* to_receive = malloc(sizeof(int));
+    int me = my_rank + 1;
+    int left_child = 2 * me;
+    int right_child = 2 * me + 1;
+
+    if (left_child < world_size + 1) {
+        if (tryToGroupReceive(FD_CHILD_IN(&fds, 0), 
+            to_receive, sizeof(char)) == -1) {
+            free(to_receive);
+            return MIMPI_ERROR_REMOTE_FINISHED;
+        }
+    }
+
+    if (right_child < world_size + 1) 
+    {
+        if (tryToGroupReceive(FD_CHILD_IN(&fds, 1), 
+            to_receive, sizeof(char)) == -1) {
+            free(to_receive);
+            return MIMPI_ERROR_REMOTE_FINISHED;
+        }
+    }
+
+    if (me != 1) 
+    {
+        if (tryToGroupSend(FD_PARENT_OUT(&fds), &to_send, sizeof(char)) == -1) {
+            free(to_receive);
+            return MIMPI_ERROR_REMOTE_FINISHED;
+        }
+
+        if(tryToGroupReceive(FD_PARENT_IN(&fds), 
+            to_receive, sizeof(char)) == -1) {
+            free(to_receive);
+            return MIMPI_ERROR_REMOTE_FINISHED;
+        }
+    }
+
+    if (left_child < world_size + 1) {
+        if(tryToGroupSend(FD_CHILD_OUT(&fds, 0), &to_send, sizeof(char)) == -1) {
+            free(to_receive);
+            return MIMPI_ERROR_REMOTE_FINISHED;
+        }
+    }
+
+    if (right_child < world_size + 1) {
+        if(tryToGroupSend(FD_CHILD_OUT(&fds, 1), &to_send, sizeof(char)) == -1) {
+            free(to_receive);
+            return MIMPI_ERROR_REMOTE_FINISHED;
+        }
+    }
+
+    free(to_receive);
+
+    return MIMPI_SUCCESS;
+}
+
+/*
+    In round k every rank signals rank + 2^k and waits for rank - 2^k, so
+    after ceil(log2(n)) rounds everybody has heard from everybody, directly
+    or not. A rank that fails to hear from its partner keeps going, but
+    signals failure instead, so every rank that has not heard from somebody
+    learns of it just as through the tree.
+*/
+static MIMPI_Retcode disseminationBarrier(MIMPI_Comm comm) {
+    char status = MIMPI_SUCCESS;
+
+    for (int distance = 1; distance < comm -> size; distance *= 2) {
+        int to = (comm -> rank + distance) % comm -> size;
+        int from = (comm -> rank - distance + comm -> size) % comm -> size;
+        char heard;
+
+        if (Send(&status, sizeof(status), to, TAG_BARRIER, comm) != 
+            MIMPI_SUCCESS) {
+            status = MIMPI_ERROR_REMOTE_FINISHED;
+        }
+
+        if (Search(&heard, sizeof(heard), from, TAG_BARRIER, comm) != 
+            MIMPI_SUCCESS) {
+            status = MIMPI_ERROR_REMOTE_FINISHED;
+        }
+        else if (heard != MIMPI_SUCCESS) {
+            status = heard;
+        }
+    }
+
+    return status;
+}
+
+// EXTERN FUNCTIONS
+
+const char* collectiveName(collective_kind collective) {
+    return registry[collective].name;
+}
+
+const char* const* collectiveAlgorithms(collective_kind collective) {
+    return registry[collective].algorithms;
+}
+
+void forceAlgorithm(collective_kind collective, const char* algorithm) {
+    forced[collective] = -1;
+    if (algorithm != NULL) {
+        forced[collective] = algorithmIndex(collective, algorithm);
+        if (forced[collective] == -1) {
+            fatal("Unknown algorithm %s of %s", algorithm, 
+                registry[collective].name);
+        }
+    }
+}
+
+/* Group pipes only connect the world, so others always disseminate. */
+MIMPI_Retcode Barrier(MIMPI_Comm comm) {
+    if (comm != MIMPI_COMM_WORLD) {
+        return disseminationBarrier(comm);
+    }
+
+    switch (chooseAlgorithm(COLLECTIVE_BARRIER, 0, BARRIER_TREE, comm)) {
+    case BARRIER_DISSEMINATION:
+        return disseminationBarrier(comm);
+    
+    default:
+        return treeBarrier();
+    }
+}
+
+/*
+    Ranks report to the root up the tree of the root, then the data comes
+    down in segments, each passed on as soon as it arrives, so all levels of
+    the tree work on the message at once. At least one (possibly empty)
+    segment goes down, so nobody leaves before everybody has arrived.
+*/
+static MIMPI_Retcode binaryBcast(void *data, int count, int root, 
+    MIMPI_Comm comm) {
+    const tree_topology* tree = treeOf(root, comm);
+    char token = 1;
+    MIMPI_Retcode ret;
+
+    for (int i = 0; i < tree -> child_count; i++) {
+        ret = Search(&token, sizeof(token), tree -> children[i], TAG_BCAST, 
+            comm);
+        if (ret != MIMPI_SUCCESS) {
+            return ret;
+        }
+    }
+
+    if (tree -> parent != -1) {
+        ret = Send(&token, sizeof(token), tree -> parent, TAG_BCAST, comm);
+        if (ret != MIMPI_SUCCESS) {
+            return ret;
+        }
+    }
+
+    int offset = 0;
+    do {
+        int segment = (count - offset > bcast_segment) ? bcast_segment : 
+            (count - offset);
+
+        if (tree -> parent != -1) {
+            ret = Search(data + offset, segment, tree -> parent, TAG_BCAST, 
+                comm);
+            if (ret != MIMPI_SUCCESS) {
+                return ret;
+            }
+        }
+
+        for (int i = 0; i < tree -> child_count; i++) {
+            ret = TreeSend(data + offset, segment, tree -> children[i], 
+                TAG_BCAST, comm);
+            if (ret != MIMPI_SUCCESS) {
+                return ret;
+            }
+        }
+
+        offset += segment;
+    } while (offset < count);
+
+    return MIMPI_SUCCESS;
+}
+
+/*
+    Partial results flow up the tree of the root in segments, so the result
+    ends up right where it is needed and all levels of the tree work at once.
+    Each segment from the children is combined in place into an accumulator
+    that is recv_data at the root and a single segment elsewhere, so scratch
+    memory does not grow with count. Segments hold whole elements of the
+    datatype. A token then comes back down, so nobody leaves before
+    everybody has arrived.
+*/
+static MIMPI_Retcode binaryReduce(
+    void const *send_data,
+    void *recv_data,
+    int elements,
+    MIMPI_Datatype datatype,
+    MIMPI_Op op,
+    int root,
+    MIMPI_Comm comm
+) {
+    const tree_topology* tree = treeOf(root, comm);
+    int width = reduceWidth(datatype);
+    int count = elements * width;
+    int step = (reduce_segment < width) ? width : 
+        reduce_segment / width * width;
+    int scratch = (count > step) ? step : count;
+    u_int8_t* acc = (comm -> rank == root) ? recv_data : malloc(scratch);
+    u_int8_t* other = (tree -> child_count > 0) ? malloc(scratch) : NULL;
+    char token = 2;
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+
+    int offset = 0;
+    do {
+        int segment = (count - offset > step) ? step : (count - offset);
+        u_int8_t* part = (comm -> rank == root) ? acc + offset : acc;
+
+        memcpy(part, send_data + offset, segment);
+
+        for (int i = 0; i < tree -> child_count && ret == MIMPI_SUCCESS; i++) {
+            ret = Search(other, segment, tree -> children[i], TAG_REDUCE, 
+                comm);
+            if (ret == MIMPI_SUCCESS) {
+                reduceInto(part, other, segment / width, datatype, op);
             }
-            tab1++;
-            tab2++;
         }
-        break;
 
-    case MIMPI_PROD:
-        for (int i = 0; i < count; i++) {
-            one = *(u_int8_t*) tab1;
-            two = *(u_int8_t*) tab2;
+        if (tree -> parent != -1 && ret == MIMPI_SUCCESS) {
+            ret = TreeSend(part, segment, tree -> parent, TAG_REDUCE, comm);
+        }
+
+        offset += segment;
+    } while (offset < count && ret == MIMPI_SUCCESS);
+
+    if (tree -> parent != -1 && ret == MIMPI_SUCCESS) {
+        ret = Search(&token, sizeof(token), tree -> parent, TAG_REDUCE, comm);
+    }
+
+    for (int i = 0; i < tree -> child_count && ret == MIMPI_SUCCESS; i++) {
+        ret = Send(&token, sizeof(token), tree -> children[i], TAG_REDUCE, 
+            comm);
+    }
+
+    if (comm -> rank != root) {
+        free(acc);
+    }
+    free(other);
+
+    return ret;
+}
+
+/*
+    Tokens go up the binomial tree of the root, then the whole message comes
+    down it, to the largest subtrees first. That takes fewer rounds than the
+    binary tree, but nothing is pipelined.
+*/
+static MIMPI_Retcode binomialBcast(void *data, int count, int root, 
+    MIMPI_Comm comm) {
+    int me = (comm -> rank - root + comm -> size) % comm -> size;
+    int span = binomialSpan(me, comm);
+    int parent = (me == 0) ? -1 : (me - span + root) % comm -> size;
+    char token = 1;
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+
+    for (int mask = 1; mask < span && me + mask < comm -> size; mask *= 2) {
+        ret = Search(&token, sizeof(token), (me + mask + root) % comm -> size, 
+            TAG_BCAST, comm);
+        if (ret != MIMPI_SUCCESS) {
+            return ret;
+        }
+    }
+
+    if (parent != -1) {
+        ret = Send(&token, sizeof(token), parent, TAG_BCAST, comm);
+        if (ret == MIMPI_SUCCESS) {
+            ret = Search(data, count, parent, TAG_BCAST, comm);
+        }
+    }
+
+    for (int mask = span / 2; mask > 0 && ret == MIMPI_SUCCESS; mask /= 2) {
+        if (me + mask < comm -> size) {
+            ret = TreeSend(data, count, (me + mask + root) % comm -> size, 
+                TAG_BCAST, comm);
+        }
+    }
+
+    return ret;
+}
 
-            res_tab[i] = one * two;
+MIMPI_Retcode Bcast(void *data, int count, int root, MIMPI_Comm comm) {
+    switch (chooseAlgorithm(COLLECTIVE_BCAST, count, BCAST_BINARY, comm)) {
+    case BCAST_BINOMIAL:
+        return binomialBcast(data, count, root, comm);
+    
+    default:
+        return binaryBcast(data, count, root, comm);
+    }
+}
 
-            tab1++;
-            tab2++;
+/*
+    Whole vectors go up the binomial tree of the root, each rank folding in
+    those of its children, and a token comes back down. That takes fewer
+    rounds than the binary tree, but nothing is pipelined.
+*/
+static MIMPI_Retcode binomialReduce(
+    void const *send_data,
+    void *recv_data,
+    int elements,
+    MIMPI_Datatype datatype,
+    MIMPI_Op op,
+    int root,
+    MIMPI_Comm comm
+) {
+    int me = (comm -> rank - root + comm -> size) % comm -> size;
+    int span = binomialSpan(me, comm);
+    int parent = (me == 0) ? -1 : (me - span + root) % comm -> size;
+    int count = elements * reduceWidth(datatype);
+    u_int8_t* acc = (comm -> rank == root) ? recv_data : malloc(count);
+    u_int8_t* other = (span > 1) ? malloc(count) : NULL;
+    char token = 2;
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+
+    memcpy(acc, send_data, count);
+
+    for (int mask = 1; mask < span && me + mask < comm -> size && 
+        ret == MIMPI_SUCCESS; mask *= 2) {
+        ret = Search(other, count, (me + mask + root) % comm -> size, 
+            TAG_REDUCE, comm);
+        if (ret == MIMPI_SUCCESS) {
+            reduceInto(acc, other, elements, datatype, op);
         }
-        break;
-
-    case MIMPI_SUM:
-        for (int i = 0; i < count; i++) {
-            one = *(u_int8_t*) tab1;
-            two = *(u_int8_t*) tab2;
+    }
 
-            res_tab[i] = one + two;
+    if (parent != -1 && ret == MIMPI_SUCCESS) {
+        ret = TreeSend(acc, count, parent, TAG_REDUCE, comm);
+        if (ret == MIMPI_SUCCESS) {
+            ret = Search(&token, sizeof(token), parent, TAG_REDUCE, comm);
+        }
+    }
 
-            tab1++;
-            tab2++;
+    for (int mask = span / 2; mask > 0 && ret == MIMPI_SUCCESS; mask /= 2) {
+        if (me + mask < comm -> size) {
+            ret = Send(&token, sizeof(token), 
+                (me + mask + root) % comm -> size, TAG_REDUCE, comm);
         }
-        break;
-    
-    default:
-        break;
     }
 
-    return res_tab;
-}
+    if (comm -> rank != root) {
+        free(acc);
+    }
+    free(other);
 
-// EXTERN FUNCTIONS
+    return ret;
+}
 
-MIMPI_Retcode Barrier(void) {
-    int to_send = 3;
-    int* to_receive = malloc(sizeof(int));
-    int me = my_rank + 1;
-    int left_child = 2 * me;
-    int right_child = 2 * me + 1;
+MIMPI_Retcode Reduce(
+    void const *send_data,
+    void *recv_data,
+    int elements,
+    MIMPI_Datatype datatype,
+    MIMPI_Op op,
+    int root,
+    MIMPI_Comm comm
+) {
+    long long count = (long long) elements * reduceWidth(datatype);
+    switch (chooseAlgorithm(COLLECTIVE_REDUCE, count, REDUCE_BINARY, comm)) {
+    case REDUCE_BINOMIAL:
+        return binomialReduce(send_data, recv_data, elements, datatype, op, 
+            root, comm);
+    
+    default:
+        return binaryReduce(send_data, recv_data, elements, datatype, op, 
+            root, comm);
+    }
+}
 
-    if (left_child < world_size + 1) {
-        if (tryToGroupReceive((700 + 6 * me + 1 - 3), 
-            to_receive, sizeof(char)) == -1) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
+/*
+    Ranks exchange vectors with partners at growing distances and combine
+    them, so after log2(n) steps everybody holds the result. Ranks beyond
+    the largest power of two first fold their vectors into partners below
+    it and get the result back at the end. The lower rank's vector always
+    comes first in a combination, so every rank computes the same result.
+*/
+static MIMPI_Retcode recursiveDoublingAllreduce(u_int8_t* acc, int elements, 
+    MIMPI_Datatype datatype, MIMPI_Op op, MIMPI_Comm comm) {
+    int count = elements * reduceWidth(datatype);
+    int power = 1;
+    while (2 * power <= comm -> size) {
+        power *= 2;
+    }
+    u_int8_t* other = malloc(count);
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+
+    if (comm -> rank >= power) {
+        ret = Send(acc, count, comm -> rank - power, TAG_ALLREDUCE, comm);
+        if (ret == MIMPI_SUCCESS) {
+            ret = Search(acc, count, comm -> rank - power, TAG_ALLREDUCE, 
+                comm);
         }
+        free(other);
+        return ret;
     }
 
-    if (right_child < world_size + 1) 
-    {
-        if (tryToGroupReceive((700 + 6 * me + 2 - 3), 
-            to_receive, sizeof(char)) == -1) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
+    if (comm -> rank + power < comm -> size) {
+        ret = Search(other, count, comm -> rank + power, TAG_ALLREDUCE, comm);
+        if (ret == MIMPI_SUCCESS) {
+            reduceInto(acc, other, elements, datatype, op);
         }
     }
 
-    if (me != 1) 
-    {
-        if (tryToGroupSend((700 + 6 * me + 0), &to_send, sizeof(char)) == -1) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
+    for (int mask = 1; mask < power && ret == MIMPI_SUCCESS; mask *= 2) {
+        int partner = comm -> rank ^ mask;
+        ret = Exchange(acc, count, partner, other, count, partner, 
+            TAG_ALLREDUCE, comm);
+        if (ret != MIMPI_SUCCESS) {
+            break;
         }
 
-        if(tryToGroupReceive((700 + 6 * me + 0 - 3), 
-            to_receive, sizeof(char)) == -1) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
+        if (partner < comm -> rank) {
+            reduceInto(other, acc, elements, datatype, op);
+            memcpy(acc, other, count);
+        }
+        else {
+            reduceInto(acc, other, elements, datatype, op);
         }
     }
 
-    if (left_child < world_size + 1) {
-        if(tryToGroupSend((700 + 6 * me + 1), &to_send, sizeof(char)) == -1) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
-        }
+    if (comm -> rank + power < comm -> size && ret == MIMPI_SUCCESS) {
+        ret = Send(acc, count, comm -> rank + power, TAG_ALLREDUCE, comm);
     }
 
-    if (right_child < world_size + 1) {
-        if(tryToGroupSend((700 + 6 * me + 2), &to_send, sizeof(char)) == -1) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
+    free(other);
+    return ret;
+}
+
+/* First element of a chunk when elements are split into a chunk per rank. */
+static int chunkStart(int elements, int chunk, MIMPI_Comm comm) {
+    return (long long) elements * chunk / comm -> size;
+}
+
+static int chunkLength(int elements, int chunk, MIMPI_Comm comm) {
+    return chunkStart(elements, chunk + 1, comm) - 
+        chunkStart(elements, chunk, comm);
+}
+
+/*
+    The vector is split into n chunks. In the first n - 1 steps every rank
+    passes a chunk to the right and folds in the one from the left, so each
+    chunk is reduced along the ring into a single rank. In the next n - 1
+    steps the reduced chunks travel around the ring to everybody. Each rank
+    sends and receives about 2 * count bytes, whatever the number of ranks.
+*/
+static MIMPI_Retcode ringAllreduce(u_int8_t* acc, int elements, 
+    MIMPI_Datatype datatype, MIMPI_Op op, MIMPI_Comm comm) {
+    int size = comm -> size;
+    int rank = comm -> rank;
+    int width = reduceWidth(datatype);
+    int right = (rank + 1) % size;
+    int left = (rank - 1 + size) % size;
+    u_int8_t* other = malloc((elements / size + 1) * width);
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+
+    for (int step = 0; step < size - 1 && ret == MIMPI_SUCCESS; step++) {
+        int out = (rank - step + size) % size;
+        int in = (rank - step - 1 + 2 * size) % size;
+        ret = Exchange(acc + chunkStart(elements, out, comm) * width, 
+            chunkLength(elements, out, comm) * width, right, 
+            other, chunkLength(elements, in, comm) * width, left, 
+            TAG_ALLREDUCE, comm);
+        if (ret == MIMPI_SUCCESS) {
+            reduceInto(acc + chunkStart(elements, in, comm) * width, other, 
+                chunkLength(elements, in, comm), datatype, op);
         }
     }
 
-    free(to_receive);
+    for (int step = 0; step < size - 1 && ret == MIMPI_SUCCESS; step++) {
+        int out = (rank + 1 - step + size) % size;
+        int in = (rank - step + size) % size;
+        ret = Exchange(acc + chunkStart(elements, out, comm) * width, 
+            chunkLength(elements, out, comm) * width, right, 
+            acc + chunkStart(elements, in, comm) * width, 
+            chunkLength(elements, in, comm) * width, left, TAG_ALLREDUCE, 
+            comm);
+    }
 
-    return MIMPI_SUCCESS;
+    free(other);
+    return ret;
 }
 
-MIMPI_Retcode Bcast(void *data, int count, int root) {
-    int to_send = 1;
-    int* to_receive = malloc(sizeof(int));
-    int me = my_rank + 1;
-    int left_child = 2 * me;
-    int right_child = 2 * me + 1;
+/*
+    Recursive doubling moves the whole vector log2(n) times but takes few
+    steps, so it wins for small vectors. The ring moves about twice the
+    vector in 2(n - 1) steps, so it takes over once the vector is large
+    and has at least an element for every rank.
+*/
+MIMPI_Retcode Allreduce(
+    void const *send_data,
+    void *recv_data,
+    int elements,
+    MIMPI_Datatype datatype,
+    MIMPI_Op op,
+    MIMPI_Comm comm
+) {
+    int count = elements * reduceWidth(datatype);
+    memcpy(recv_data, send_data, count);
 
-    if (root == my_rank && me != 1) {
-        if(GroupSend((900 + 4 * me + 2), data, count) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
-        }
+    if (comm -> size == 1) {
+        return MIMPI_SUCCESS;
     }
 
-    if (me == 1 && root != my_rank) {
-        if (GroupRecv((900 + 4 * (root + 1) + 1), data, count) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
-        }   
+    int fallback = (count >= allreduce_ring && elements >= comm -> size) ? 
+        ALLREDUCE_RING : ALLREDUCE_RECURSIVE_DOUBLING;
+    switch (chooseAlgorithm(COLLECTIVE_ALLREDUCE, count, fallback, comm)) {
+    case ALLREDUCE_RING:
+        return ringAllreduce(recv_data, elements, datatype, op, comm);
+    
+    default:
+        return recursiveDoublingAllreduce(recv_data, elements, datatype, op, 
+            comm);
     }
+}
 
-    if (left_child < world_size + 1) {
-        if (GroupRecv((700 + 6 * me + 1 - 3), to_receive, sizeof(char)) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
-        }
+/*
+    Blocks go up a binomial tree over ranks rotated so that the root is 0.
+    A rank v collects the blocks of ranks v to v + 2^k - 1, where 2^k is the
+    lowest set bit of v, concatenated in that order, and passes them on as
+    one message, so the root is done after log2(n) rounds. A token then
+    goes back down the same tree, so nobody leaves before everybody has
+    arrived.
+*/
+MIMPI_Retcode Gather(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    int root,
+    MIMPI_Comm comm
+) {
+    int me = (comm -> rank - root + comm -> size) % comm -> size;
+    int span = binomialSpan(me, comm);
+    int subtree = (comm -> size - me < span) ? comm -> size - me : span;
+    char token = 5;
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+
+    /* The root gathers straight into recv_data if no rotation is needed. */
+    u_int8_t* blocks;
+    if (comm -> rank == 0 && root == 0) {
+        blocks = recv_data;
+    }
+    else if (subtree > 1) {
+        blocks = malloc((size_t) subtree * count);
+    }
+    else {
+        blocks = (u_int8_t*) send_data;
+    }
+    if (blocks != send_data) {
+        memcpy(blocks, send_data, count);
     }
 
-    if (right_child < world_size + 1) {
-        if (GroupRecv((700 + 6 * me + 2 - 3), to_receive, sizeof(char)) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
+    for (int mask = 1; mask < span && me + mask < comm -> size; mask *= 2) {
+        int blocks_in = (comm -> size - me - mask < mask) ? 
+            comm -> size - me - mask : mask;
+        ret = Search(blocks + (size_t) mask * count, blocks_in * count, 
+            (me + mask + root) % comm -> size, TAG_GATHER, comm);
+        if (ret != MIMPI_SUCCESS) {
+            break;
         }
     }
 
-    if (me != 1) {
-        if(GroupSend((700 + 6 * me + 0), &to_send, sizeof(char)) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
+    if (me != 0 && ret == MIMPI_SUCCESS) {
+        int parent = (me - span + root) % comm -> size;
+        ret = TreeSend(blocks, subtree * count, parent, TAG_GATHER, comm);
+        if (ret == MIMPI_SUCCESS) {
+            ret = Search(&token, sizeof(token), parent, TAG_GATHER, comm);
         }
+    }
+    else if (me == 0 && root != 0 && ret == MIMPI_SUCCESS) {
+        size_t head = (size_t) (comm -> size - root) * count;
+        memcpy(recv_data + (size_t) root * count, blocks, head);
+        memcpy(recv_data, blocks + head, (size_t) root * count);
+    }
 
-        if (GroupRecv((700 + 6 * me + 0 - 3), data, count) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
+    for (int mask = span / 2; mask > 0 && ret == MIMPI_SUCCESS; mask /= 2) {
+        if (me + mask < comm -> size) {
+            ret = Send(&token, sizeof(token), 
+                (me + mask + root) % comm -> size, TAG_GATHER, comm);
         }
     }
 
-    if (left_child < world_size + 1) {
-        if(GroupSend((700 + 6 * me + 1), data, count) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
-        }
+    if (blocks != recv_data && blocks != send_data) {
+        free(blocks);
     }
 
-    if (right_child < world_size + 1) {
-        if(GroupSend((700 + 6 * me + 2), data, count) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);
-            return MIMPI_ERROR_REMOTE_FINISHED;
-        }
+    return ret;
+}
+
+/*
+    Ranks swap everything they hold with partners at growing distances,
+    which takes log2(n) steps, but only for a number of ranks that is a
+    power of two.
+*/
+static MIMPI_Retcode recursiveDoublingAllgather(u_int8_t* blocks, int count, 
+    MIMPI_Comm comm) {
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+
+    for (int mask = 1; mask < comm -> size && ret == MIMPI_SUCCESS; mask *= 2) {
+        int partner = comm -> rank ^ mask;
+        int mine = comm -> rank & ~(mask - 1);
+        int theirs = partner & ~(mask - 1);
+        ret = Exchange(blocks + (size_t) mine * count, mask * count, 
+            partner, blocks + (size_t) theirs * count, mask * count, 
+            partner, TAG_ALLGATHER, comm);
     }
 
-    free(to_receive);
+    return ret;
+}
 
-    return MIMPI_SUCCESS;
+/* Each block travels around a ring in n - 1 steps, one block per step. */
+static MIMPI_Retcode ringAllgather(u_int8_t* blocks, int count, 
+    MIMPI_Comm comm) {
+    int size = comm -> size;
+    int rank = comm -> rank;
+    int right = (rank + 1) % size;
+    int left = (rank - 1 + size) % size;
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+
+    for (int step = 0; step < size - 1 && ret == MIMPI_SUCCESS; step++) {
+        int out = (rank - step + size) % size;
+        int in = (rank - step - 1 + 2 * size) % size;
+        ret = Exchange(blocks + (size_t) out * count, count, right, 
+            blocks + (size_t) in * count, count, left, TAG_ALLGATHER, comm);
+    }
+
+    return ret;
 }
 
-MIMPI_Retcode Reduce(
+/*
+    Recursive doubling is the default for small blocks if the number of
+    ranks allows it, and the ring for the rest. The ring also stands in for
+    recursive doubling chosen for a number of ranks it cannot handle.
+*/
+MIMPI_Retcode Allgather(
     void const *send_data,
     void *recv_data,
     int count,
-    MIMPI_Op op,
-    int root
+    MIMPI_Comm comm
 ) {
-    int to_send = 2;
-    int* to_receive = malloc(sizeof(int));
-    void* tab1 = malloc(count);
-    void* tab2 = malloc(count);
-    u_int8_t* res_tab;
-    u_int8_t* mid_tab;
-    bool same = false;
-    int me = my_rank + 1;
-    int left_child = 2 * me;
-    int right_child = 2 * me + 1;
+    bool power = (comm -> size & (comm -> size - 1)) == 0;
+    int fallback = 
+        (power && (long long) count * comm -> size < allgather_ring) ?
+        ALLGATHER_RECURSIVE_DOUBLING : ALLGATHER_RING;
 
-    if (left_child < world_size + 1) {
-        if (GroupRecv((700 + 6 * me + 1 - 3), tab1, count) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);
-            free(tab1);
-            free(tab2);
-            return MIMPI_ERROR_REMOTE_FINISHED;
+    memcpy(recv_data + (size_t) comm -> rank * count, send_data, count);
+
+    if (chooseAlgorithm(COLLECTIVE_ALLGATHER, count, fallback, comm) == 
+        ALLGATHER_RECURSIVE_DOUBLING && power) {
+        return recursiveDoublingAllgather(recv_data, count, comm);
+    }
+    return ringAllgather(recv_data, count, comm);
+}
+
+/*
+    Tokens first go up the binomial tree of the root, so nobody leaves
+    before everybody has arrived. Then every rank receives from its parent
+    the blocks of its whole subtree as one message, keeps the first one
+    and passes on to each child the part for the child's subtree, so the
+    root sends every byte once and the data is spread in log2(n) rounds.
+    Without variable blocks all of them have count bytes. Otherwise only
+    the root knows their sizes, so each rank first gets those of its
+    subtree.
+*/
+static MIMPI_Retcode scatterTree(
+    void const *send_data,
+    const int* counts,
+    const int* displs,
+    int count,
+    bool variable,
+    void *recv_data,
+    int root,
+    MIMPI_Comm comm
+) {
+    int me = (comm -> rank - root + comm -> size) % comm -> size;
+    int span = binomialSpan(me, comm);
+    int subtree = (comm -> size - me < span) ? comm -> size - me : span;
+    int parent = (me == 0) ? -1 : (me - span + root) % comm -> size;
+    char token = 7;
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+
+    for (int mask = 1; mask < span && me + mask < comm -> size; mask *= 2) {
+        ret = Search(&token, sizeof(token), (me + mask + root) % comm -> size, 
+            TAG_SCATTER, comm);
+        if (ret != MIMPI_SUCCESS) {
+            return ret;
+        }
+    }
+    if (parent != -1) {
+        ret = Send(&token, sizeof(token), parent, TAG_SCATTER, comm);
+        if (ret != MIMPI_SUCCESS) {
+            return ret;
+        }
+    }
+
+    /* Sizes of the blocks of the subtree, from me, and where each starts. */
+    int* lengths = malloc(subtree * sizeof(int));
+    for (int v = 0; v < subtree; v++) {
+        lengths[v] = count;
+    }
+    if (variable && parent == -1) {
+        for (int v = 0; v < subtree; v++) {
+            lengths[v] = counts[(v + root) % comm -> size];
+        }
+    }
+    else if (variable) {
+        ret = Search(lengths, subtree * sizeof(int), parent, TAG_SCATTER, 
+            comm);
+        if (ret != MIMPI_SUCCESS) {
+            free(lengths);
+            return ret;
         }
-        mid_tab = reducer(tab1, send_data, count, op); 
     }
-    else {
-        mid_tab = malloc(count);
 
-        memcpy(mid_tab, send_data, count);
+    long long total = 0;
+    for (int v = 0; v < subtree; v++) {
+        total += lengths[v];
     }
 
-    if (right_child < world_size + 1) {
-        if (GroupRecv((700 + 6 * me + 2 - 3), tab2, count) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);
-            free(tab1);
-            free(tab2);
-            free(mid_tab);
-            return MIMPI_ERROR_REMOTE_FINISHED;
+    /* Blocks of the subtree, in the order of rotated ranks. */
+    u_int8_t* blocks;
+    if (parent == -1 && !variable && root == 0) {
+        blocks = (u_int8_t*) send_data;
+    }
+    else if (parent == -1) {
+        blocks = malloc(total);
+        long long offset = 0;
+        for (int v = 0; v < subtree; v++) {
+            int rank = (v + root) % comm -> size;
+            long long from = variable ? displs[rank] : 
+                (long long) rank * count;
+            memcpy(blocks + offset, send_data + from, lengths[v]);
+            offset += lengths[v];
         }
-        res_tab = reducer(tab2, mid_tab, count, op);
     }
     else {
-        res_tab = mid_tab;
-        same = true;
+        blocks = (subtree > 1) ? malloc(total) : recv_data;
+        ret = Search(blocks, total, parent, TAG_SCATTER, comm);
     }
 
-    if (me != 1) {
-        if(GroupSend((700 + 6 * me + 0), res_tab, count) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);
-            free(tab1);
-            free(tab2);
-            if (same) {
-                free(res_tab);
+    for (int mask = span / 2; mask > 0 && ret == MIMPI_SUCCESS; mask /= 2) {
+        if (me + mask >= comm -> size) {
+            continue;
+        }
+        int child = (me + mask + root) % comm -> size;
+        int child_blocks = (comm -> size - me - mask < mask) ? 
+            comm -> size - me - mask : mask;
+        long long start = 0;
+        long long length = 0;
+        for (int v = 0; v < mask + child_blocks; v++) {
+            if (v < mask) {
+                start += lengths[v];
             }
             else {
-                free(res_tab);
-                free(mid_tab);
+                length += lengths[v];
             }
-            return MIMPI_ERROR_REMOTE_FINISHED;
         }
 
-        if (GroupRecv((700 + 6 * me + 0 - 3), 
-            to_receive, sizeof(char)) == MIMPI_ERROR_REMOTE_FINISHED) {
-                free(to_receive);     
-            free(tab1);
-            free(tab2);
-            if (same) {
-                free(res_tab);
-            }
-            else {
-                free(res_tab);
-                free(mid_tab);
-            }
-            return MIMPI_ERROR_REMOTE_FINISHED;
+        if (variable) {
+            ret = Send(lengths + mask, child_blocks * sizeof(int), child, 
+                TAG_SCATTER, comm);
+        }
+        if (ret == MIMPI_SUCCESS) {
+            ret = TreeSend(blocks + start, length, child, TAG_SCATTER, comm);
         }
     }
 
-    if (left_child < world_size + 1) {
-        if(GroupSend((700 + 6 * me + 1), &to_send, sizeof(char)) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);     
-            free(tab1);
-            free(tab2);
-            if (same) {
-                free(res_tab);
-            }
-            else {
-                free(res_tab);
-                free(mid_tab);
-            }
-            return MIMPI_ERROR_REMOTE_FINISHED;
-        }
+    if (ret == MIMPI_SUCCESS && blocks != recv_data) {
+        memcpy(recv_data, blocks, lengths[0]);
     }
 
-    if (right_child < world_size + 1) {
-        if(GroupSend((700 + 6 * me + 2), &to_send, sizeof(char)) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);     
-            free(tab1);
-            free(tab2);
-            if (same) {
-                free(res_tab);
-            }
-            else {
-                free(res_tab);
-                free(mid_tab);
-            }
-            return MIMPI_ERROR_REMOTE_FINISHED;
-        }
+    if (blocks != send_data && blocks != recv_data) {
+        free(blocks);
+    }
+    free(lengths);
+
+    return ret;
+}
+
+MIMPI_Retcode Scatter(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    int root,
+    MIMPI_Comm comm
+) {
+    return scatterTree(send_data, NULL, NULL, count, false, recv_data, root, 
+        comm);
+}
+
+MIMPI_Retcode Scatterv(
+    void const *send_data,
+    const int* counts,
+    const int* displs,
+    void *recv_data,
+    int root,
+    MIMPI_Comm comm
+) {
+    return scatterTree(send_data, counts, displs, 0, true, recv_data, root, 
+        comm);
+}
+
+/* Size of the block of a rank, given by counts or count if there are none. */
+static int blockCount(const int* counts, int count, int rank) {
+    return (counts != NULL) ? counts[rank] : count;
+}
+
+/* Offset of the block of a rank, given by displs or rank * count. */
+static long long blockOffset(const int* displs, int count, int rank) {
+    return (displs != NULL) ? displs[rank] : (long long) rank * count;
+}
+
+/*
+    In step s every rank exchanges blocks with exactly one partner: rank
+    r ^ s if the number of ranks is a power of two, otherwise it sends to r + s
+    and receives from r - s. No rank is ever the target of two senders at
+    once. Without counts every block has count bytes and block i sits at
+    offset i * count.
+*/
+static MIMPI_Retcode pairwiseExchange(
+    void const *send_data,
+    const int* send_counts,
+    const int* send_displs,
+    void *recv_data,
+    const int* recv_counts,
+    const int* recv_displs,
+    int count,
+    MIMPI_Comm comm
+) {
+    bool power = (comm -> size & (comm -> size - 1)) == 0;
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+
+    memcpy(recv_data + blockOffset(recv_displs, count, comm -> rank), 
+        send_data + blockOffset(send_displs, count, comm -> rank), 
+        blockCount(send_counts, count, comm -> rank));
+
+    for (int step = 1; step < comm -> size && ret == MIMPI_SUCCESS; step++) {
+        int destination = power ? (comm -> rank ^ step) : 
+            (comm -> rank + step) % comm -> size;
+        int source = power ? (comm -> rank ^ step) : 
+            (comm -> rank - step + comm -> size) % comm -> size;
+        ret = Exchange(
+            send_data + blockOffset(send_displs, count, destination), 
+            blockCount(send_counts, count, destination), destination, 
+            recv_data + blockOffset(recv_displs, count, source), 
+            blockCount(recv_counts, count, source), source, TAG_ALLTOALL, 
+            comm);
+    }
+
+    return ret;
+}
+
+MIMPI_Retcode Alltoall(
+    void const *send_data,
+    void *recv_data,
+    int count,
+    MIMPI_Comm comm
+) {
+    return pairwiseExchange(send_data, NULL, NULL, recv_data, NULL, NULL, 
+        count, comm);
+}
+
+MIMPI_Retcode Alltoallv(
+    void const *send_data,
+    const int* send_counts,
+    const int* send_displs,
+    void *recv_data,
+    const int* recv_counts,
+    const int* recv_displs,
+    MIMPI_Comm comm
+) {
+    return pairwiseExchange(send_data, send_counts, send_displs, 
+        recv_data, recv_counts, recv_displs, 0, comm);
+}
+
+/************************ COMMUNICATORS ************************/
+static int compareMembers(const void* a, const void* b) {
+    const split_member* first = a;
+    const split_member* second = b;
+    if (first -> key != second -> key) {
+        return (first -> key < second -> key) ? -1 : 1;
+    }
+    return (first -> rank < second -> rank) ? -1 : 1;
+}
+
+int CommRank(MIMPI_Comm comm) {
+    return comm -> rank;
+}
+
+int CommSize(MIMPI_Comm comm) {
+    return comm -> size;
+}
+
+int CommWorldRank(MIMPI_Comm comm, int rank) {
+    return comm -> ranks[rank];
+}
+
+static bool contextUsed(int context) {
+    return (used_contexts[context / 64] >> (context % 64)) & 1;
+}
+
+/* Lowest context from the given one on that this rank does not use. */
+static int lowestFreeContext(int from) {
+    int context = from;
+    while (context < CONTEXT_LIMIT && contextUsed(context)) {
+        context++;
+    }
+    if (context >= CONTEXT_LIMIT) {
+        fatal("Out of communicator contexts (%d)", CONTEXT_LIMIT);
+    }
+    return context;
+}
+
+/*
+    Ranks gather their colors, keys and the lowest contexts they do not use.
+    If those differ, the largest one may be in use by some ranks, so they
+    gather again their lowest free contexts from it on, until all agree.
+    Members that free their communicators in the same order agree at once.
+    Communicators of different colors share the context, as they have no
+    members in common.
+*/
+MIMPI_Retcode CommSplit(MIMPI_Comm comm, int color, int key, 
+    MIMPI_Comm* new_comm) {
+    *new_comm = MIMPI_COMM_NULL;
+
+    split_entry* entries = malloc(comm -> size * sizeof(split_entry));
+    if (entries == NULL) {
+        fatal("Could not allocate split of %d ranks", comm -> size);
     }
 
-    if (me == 1 && my_rank != root) {
-        if(GroupSend((900 + 4 * (root + 1) + 0), res_tab, count) 
-            == MIMPI_ERROR_REMOTE_FINISHED) {
-            free(to_receive);     
-            free(tab1);
-            free(tab2);
-            if (same) {
-                free(res_tab);
+    int context = WORLD_CONTEXT + 1;
+    bool agreed = false;
+    while (!agreed) {
+        split_entry mine = {color, key, lowestFreeContext(context)};
+        MIMPI_Retcode ret = 
+            Allgather(&mine, entries, sizeof(split_entry), comm);
+        if (ret != MIMPI_SUCCESS) {
+            free(entries);
+            return ret;
+        }
+
+        context = entries[0].context;
+        agreed = true;
+        for (int r = 1; r < comm -> size; r++) {
+            if (entries[r].context != context) {
+                agreed = false;
             }
-            else {
-                free(res_tab);
-                free(mid_tab);
+            if (entries[r].context > context) {
+                context = entries[r].context;
             }
-            return MIMPI_ERROR_REMOTE_FINISHED;
         }
     }
 
-    if (my_rank == root) {
-        if (me != 1) {
-            if (GroupRecv((900 + 4 * me + 3), recv_data, count) 
-                == MIMPI_ERROR_REMOTE_FINISHED) {
-                free(to_receive);     
-                free(tab1);
-                free(tab2);
-                if (same) {
-                    free(res_tab);
-                }
-                else {
-                    free(res_tab);
-                    free(mid_tab);
-                }
-                return MIMPI_ERROR_REMOTE_FINISHED;
-            }
-        }
-        else {
-            memcpy(recv_data, res_tab, count);
-        }
+    if (color == MIMPI_UNDEFINED) {
+        free(entries);
+        return MIMPI_SUCCESS;
     }
 
-    free(to_receive);     
-    free(tab1);
-    free(tab2);
-    if (same) {
-        free(res_tab);
+    split_member* members = malloc(comm -> size * sizeof(split_member));
+    MIMPI_Comm split = malloc(sizeof(struct MIMPI_Comm_t));
+    if (members == NULL || split == NULL) {
+        fatal("Could not allocate a communicator");
     }
-    else {
-        free(res_tab);
-        free(mid_tab);
+    int size = 0;
+    for (int r = 0; r < comm -> size; r++) {
+        if (entries[r].color == color) {
+            members[size++] = (split_member) {entries[r].key, r};
+        }
+    }
+    qsort(members, size, sizeof(split_member), compareMembers);
+
+    used_contexts[context / 64] |= (uint64_t) 1 << (context % 64);
+    split -> size = size;
+    split -> context = context;
+    split -> ranks = malloc(size * sizeof(int));
+    split -> trees = calloc(size, sizeof(tree_topology));
+    if (split -> ranks == NULL || split -> trees == NULL) {
+        fatal("Could not allocate a communicator of %d ranks", size);
+    }
+    for (int i = 0; i < size; i++) {
+        split -> ranks[i] = comm -> ranks[members[i].rank];
+        if (members[i].rank == comm -> rank) {
+            split -> rank = i;
+        }
     }
 
+    free(members);
+    free(entries);
+    *new_comm = split;
     return MIMPI_SUCCESS;
 }
+
+/* A duplicate is a split with a single color that keeps the order. */
+MIMPI_Retcode CommDup(MIMPI_Comm comm, MIMPI_Comm* new_comm) {
+    return CommSplit(comm, 0, comm -> rank, new_comm);
+}
+
+void CommFree(MIMPI_Comm* comm) {
+    if (*comm != MIMPI_COMM_NULL && *comm != MIMPI_COMM_WORLD) {
+        int context = (*comm) -> context;
+        used_contexts[context / 64] &= ~((uint64_t) 1 << (context % 64));
+        free((*comm) -> ranks);
+        free((*comm) -> trees);
+        free(*comm);
+    }
+    *comm = MIMPI_COMM_NULL;
+}
@@ -48,29 +48,209 @@ _Noreturn extern void fatal(const char* fmt, ...);
 
 #define TODO fatal("UNIMPLEMENTED function %s", __PRETTY_FUNCTION__);
 
+/************************ FILE DESCRIPTOR TABLE ************************/
+/* First descriptor number that the table of a rank may occupy. */
+#define FD_TABLE_BASE 20
+/* Name of the environment variable describing the table of a rank. */
+#define FD_TABLE_VAR "MIMPI_FD_TABLE"
+
+/* How point-to-point bytes travel between ranks, see mimpi_transport.h. */
+typedef enum {
+    TRANSPORT_PIPE,
+    TRANSPORT_SHM,
+} transport_kind;
+
+/*
+    Registry of channel descriptors used by a single rank.
+
+    Entries are stored in a flat array and accessed with the FD_* macros below.
+    Unused entries hold -1. The layout (which entries are used and at which
+    descriptor numbers they live) is a deterministic function of world size,
+    rank, transport and base, so mimpirun and the library compute it the same
+    way and only the base and the number of entries have to be passed through
+    environment.
+*/
+typedef struct {
+    int size;
+    int rank;
+    int length;
+    transport_kind transport;
+    int* fds;
+} fd_table;
+
+#define FD_IN(t, peer)          ((t) -> fds[(peer)])
+#define FD_OUT(t, peer)         ((t) -> fds[(t) -> size + (peer)])
+#define FD_PARENT_IN(t)         ((t) -> fds[2 * (t) -> size])
+#define FD_PARENT_OUT(t)        ((t) -> fds[2 * (t) -> size + 1])
+#define FD_CHILD_IN(t, i)       ((t) -> fds[2 * (t) -> size + 2 + (i)])
+#define FD_CHILD_OUT(t, i)      ((t) -> fds[2 * (t) -> size + 4 + (i)])
+#define FD_SHM(t)               ((t) -> fds[2 * (t) -> size + 6])
+
+/* Rank of the parent of a rank in the binary heap tree rooted at rank 0. */
+#define TREE_PARENT(rank)       (((rank) + 1) / 2 - 1)
+/* Rank of the i-th (0 or 1) child of a rank in the binary heap tree. */
+#define TREE_CHILD(rank, i)     (2 * ((rank) + 1) + (i) - 1)
+
+void fdTableInit(fd_table*, int, int, transport_kind);
+int fdTableLayout(fd_table*, int);
+void fdTableFree(fd_table*);
+
+/************************ POINT TO POINT PROTOCOL ************************/
+/* Name of the environment variable with the largest eagerly sent message. */
+#define EAGER_THRESHOLD_VAR "MIMPI_EAGER_THRESHOLD"
+#define EAGER_THRESHOLD_DEFAULT (64 * 1024)
+/* Bytes a rank buffers at most for a single peer and for all peers. */
+#define PEER_BUDGET_VAR "MIMPI_PEER_BUDGET"
+#define PEER_BUDGET_DEFAULT (4 * 1024 * 1024)
+#define RANK_BUDGET_VAR "MIMPI_RANK_BUDGET"
+#define RANK_BUDGET_DEFAULT (64 * 1024 * 1024)
+/*
+    Bytes of copies MIMPI_Send holds at most for messages not received yet.
+    Sends beyond it wait for their receive instead of being copied.
+*/
+#define DETACHED_LIMIT_VAR "MIMPI_DETACHED_LIMIT"
+#define DETACHED_LIMIT_DEFAULT (64 * 1024 * 1024)
+/* Set to anything but 0 to print flow control counters in MIMPI_Finalize. */
+#define FLOW_REPORT_VAR "MIMPI_FLOW_REPORT"
+/* Set to anything but 0 to print memory pool counters in MIMPI_Finalize. */
+#define POOL_REPORT_VAR "MIMPI_POOL_REPORT"
+/*
+    Name of the environment variable with the milliseconds a receive waits,
+    with deadlock detection on, before it starts probing for a deadlock.
+*/
+#define DEADLOCK_DELAY_VAR "MIMPI_DEADLOCK_DELAY"
+#define DEADLOCK_DELAY_DEFAULT 5
+/* Tag of deadlock detection probes, consumed by the progress engine. */
+#define TAG_DEADLOCK -10
+
+/************************ GROUP PROTOCOL ************************/
+/*
+    Collectives other than MIMPI_Barrier talk over the point-to-point
+    channels with tags below zero, which user messages can never match.
+*/
+#define TAG_BCAST -2
+#define TAG_REDUCE -3
+#define TAG_ALLREDUCE -4
+#define TAG_GATHER -5
+#define TAG_ALLGATHER -6
+#define TAG_SCATTER -7
+#define TAG_ALLTOALL -8
+#define TAG_BARRIER -9
+
+/*
+    Collectives with more than one algorithm. The algorithm of a call is
+    the one named by the environment variable of the collective, if set,
+    else the one of the tuning table (see mimpi_tuning.h), else the one
+    chosen by built-in rules.
+*/
+typedef enum {
+    COLLECTIVE_BARRIER,
+    COLLECTIVE_BCAST,
+    COLLECTIVE_REDUCE,
+    COLLECTIVE_ALLREDUCE,
+    COLLECTIVE_ALLGATHER,
+    COLLECTIVES,
+} collective_kind;
+
+#define BARRIER_VAR "MIMPI_BARRIER"
+#define BCAST_VAR "MIMPI_BCAST"
+#define REDUCE_VAR "MIMPI_REDUCE"
+#define ALLREDUCE_VAR "MIMPI_ALLREDUCE"
+#define ALLGATHER_VAR "MIMPI_ALLGATHER"
+
+/* Name of the environment variable with the segment size of MIMPI_Bcast. */
+#define BCAST_SEGMENT_VAR "MIMPI_BCAST_SEGMENT"
+#define BCAST_SEGMENT_DEFAULT (16 * 1024)
+/* Name of the environment variable with the segment size of MIMPI_Reduce. */
+#define REDUCE_SEGMENT_VAR "MIMPI_REDUCE_SEGMENT"
+#define REDUCE_SEGMENT_DEFAULT (16 * 1024)
+/*
+    Name of the environment variable with the number of bytes from which
+    MIMPI_Allreduce switches from recursive doubling to the ring.
+*/
+#define ALLREDUCE_RING_VAR "MIMPI_ALLREDUCE_RING"
+#define ALLREDUCE_RING_DEFAULT (64 * 1024)
+/*
+    Name of the environment variable with the number of gathered bytes from
+    which MIMPI_Allgather uses the ring even if the world size is a power of
+    two, which recursive doubling needs.
+*/
+#define ALLGATHER_RING_VAR "MIMPI_ALLGATHER_RING"
+#define ALLGATHER_RING_DEFAULT (64 * 1024)
+
 /************************ FUNCTIONS FOR INIT ************************/
 void setMyRank(int);
 void setWorldSize(int);
 void setDeadlocks(bool);
+void loadFdTable();
 void initMutexes();
-void createReaders();
+void startProgressEngine();
 void initListsAndVariables();
 
 /************************ FUNCTIONS FOR FINALIZE ************************/
+/* Lets started non-blocking collectives end and stops their thread. */
+void stopCollectives();
 void closeGroupPipes();
 void closeWritingPointToPointPipes();
 void closeReadingPointToPointPipes();
-void waitForReaders();
+void reportFlowStats();
+/* Called once no thread uses the pool, right before the final sweep. */
+void reportPoolStats();
+void flushDetachedSends();
+void stopWriter();
+void stopProgressEngine();
 void destroyMutexes();
 void cleanListsAndVariables();
 
 /************************ POINT TO POINT FUNCTIONS ************************/
-MIMPI_Retcode Send(const void*, int, int, int);
-MIMPI_Retcode Search(void*, int, int, int);
+/* Ranks are those in the communicator, which is never MIMPI_COMM_NULL. */
+MIMPI_Retcode Send(const void*, int, int, int, MIMPI_Comm);
+/* Receive of MIMPI_Recv, which takes part in deadlock detection. */
+MIMPI_Retcode Recv(void*, int, int, int, MIMPI_Comm);
+MIMPI_Retcode Isend(const void*, int, int, int, MIMPI_Comm, MIMPI_Request*);
+MIMPI_Retcode Irecv(void*, int, int, int, MIMPI_Comm, MIMPI_Request*);
+MIMPI_Retcode Wait(MIMPI_Request*);
+MIMPI_Retcode Test(MIMPI_Request*, bool*);
+MIMPI_Retcode Waitall(int, MIMPI_Request[]);
+MIMPI_Retcode Waitany(int, MIMPI_Request[], int*);
+void FlowStats(MIMPI_Flow_stats*);
+void PoolStats(MIMPI_Pool_stats*);
 
 /************************ GROUP FUNCTIONS ************************/
-MIMPI_Retcode Barrier();
-MIMPI_Retcode Bcast(void*, int, int);
-MIMPI_Retcode Reduce(void const *, void*, int, MIMPI_Op, int);
+/* Name of a collective, as in the tuning table. */
+const char* collectiveName(collective_kind);
+/* Names of the algorithms of a collective, terminated by NULL. */
+const char* const* collectiveAlgorithms(collective_kind);
+/* Pins a collective to an algorithm, or lets it choose again for NULL. */
+void forceAlgorithm(collective_kind, const char*);
+/* Waits until started non-blocking collectives have ended. */
+void waitForCollectives();
+void Ibarrier(MIMPI_Request*);
+void Ibcast(void*, int, int, MIMPI_Request*);
+void Ireduce(const void*, void*, int, MIMPI_Op, int, MIMPI_Request*);
+
+MIMPI_Retcode Barrier(MIMPI_Comm);
+MIMPI_Retcode Bcast(void*, int, int, MIMPI_Comm);
+MIMPI_Retcode Reduce(void const *, void*, int, MIMPI_Datatype, MIMPI_Op, int, 
+    MIMPI_Comm);
+MIMPI_Retcode Allreduce(void const *, void*, int, MIMPI_Datatype, MIMPI_Op, 
+    MIMPI_Comm);
+MIMPI_Retcode Gather(void const *, void*, int, int, MIMPI_Comm);
+MIMPI_Retcode Allgather(void const *, void*, int, MIMPI_Comm);
+MIMPI_Retcode Scatter(void const *, void*, int, int, MIMPI_Comm);
+MIMPI_Retcode Scatterv(void const *, const int*, const int*, void*, int, 
+    MIMPI_Comm);
+MIMPI_Retcode Alltoall(void const *, void*, int, MIMPI_Comm);
+MIMPI_Retcode Alltoallv(void const *, const int*, const int*, 
+    void*, const int*, const int*, MIMPI_Comm);
+
+/************************ COMMUNICATORS ************************/
+int CommRank(MIMPI_Comm);
+int CommSize(MIMPI_Comm);
+/* World rank of a rank of the communicator. */
+int CommWorldRank(MIMPI_Comm, int);
+MIMPI_Retcode CommSplit(MIMPI_Comm, int, int, MIMPI_Comm*);
+MIMPI_Retcode CommDup(MIMPI_Comm, MIMPI_Comm*);
+void CommFree(MIMPI_Comm*);
 
 #endif // MIMPI_COMMON_H
\ No newline at end of file
@@ -0,0 +1,195 @@
+/**
+ * This file is for implementation of the memory pool used by MIMPI library.
+ *
+ * Small blocks are carved out of slabs and kept on per-class free lists,
+ * large blocks are plain mallocs linked together, so that the whole pool
+ * can be returned in one sweep when the library is finalised.
+ * */
+
+#include "mimpi_pool.h"
+#include "mimpi_common.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#define SLAB_SIZE (64 * 1024)
+#define LARGE_CLASS POOL_CLASSES
+
+/* Header in front of every block. Aligned to 16 bytes, like malloc. */
+typedef struct pool_block {
+    struct pool_block *prev;
+    struct pool_block *next;
+    uint32_t class;
+    uint32_t reserved;
+    size_t size;
+} __attribute__((aligned(16))) pool_block;
+
+typedef struct pool_slab {
+    struct pool_slab *next;
+} __attribute__((aligned(16))) pool_slab;
+
+static const size_t class_sizes[POOL_CLASSES] = 
+    {64, 128, 256, 512, 1024, 2048, 4096, 8192};
+
+static pthread_mutex_t pool_mutex;
+static pool_block* free_lists[POOL_CLASSES];
+static pool_slab* slabs;
+static pool_block* large_blocks;
+static pool_stats stats;
+
+void poolInit() {
+    ASSERT_ZERO(pthread_mutex_init(&pool_mutex, NULL));
+    slabs = NULL;
+    large_blocks = NULL;
+
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        free_lists[i] = NULL;
+        stats.classes[i] = (pool_class_stats) { .block_size = class_sizes[i] };
+    }
+    stats.large = (pool_class_stats) { .block_size = 0 };
+    stats.bytes = 0;
+    stats.peak_bytes = 0;
+}
+
+static int classOf(size_t size) {
+    int class = 0;
+    while (class < POOL_CLASSES && class_sizes[class] < size) {
+        class++;
+    }
+    return class;
+}
+
+size_t poolFootprint(size_t size) {
+    int class = classOf(size);
+    return sizeof(pool_block) + 
+        ((class == LARGE_CLASS) ? size : class_sizes[class]);
+}
+
+static void countAlloc(pool_class_stats* counters, size_t footprint) {
+    counters -> allocs++;
+    counters -> in_use++;
+    if (counters -> in_use > counters -> peak) {
+        counters -> peak = counters -> in_use;
+    }
+    stats.bytes += footprint;
+    if (stats.bytes > stats.peak_bytes) {
+        stats.peak_bytes = stats.bytes;
+    }
+}
+
+/* Carves a new slab into blocks of the given class. */
+static void refill(int class) {
+    size_t stride = sizeof(pool_block) + class_sizes[class];
+    size_t blocks = (SLAB_SIZE - sizeof(pool_slab)) / stride;
+    if (blocks == 0) {
+        blocks = 1;
+    }
+
+    pool_slab* slab = malloc(sizeof(pool_slab) + blocks * stride);
+    if (slab == NULL) {
+        fatal("Could not allocate a slab for %zu-byte blocks", 
+            class_sizes[class]);
+    }
+    slab -> next = slabs;
+    slabs = slab;
+    stats.classes[class].slabs++;
+
+    char* start = (char*) (slab + 1);
+    for (size_t i = 0; i < blocks; i++) {
+        pool_block* block = (pool_block*) (start + i * stride);
+        block -> class = class;
+        block -> next = free_lists[class];
+        free_lists[class] = block;
+    }
+}
+
+void* poolAlloc(size_t size) {
+    int class = classOf(size);
+
+    ASSERT_ZERO(pthread_mutex_lock(&pool_mutex));
+    pool_block* block;
+    if (class == LARGE_CLASS) {
+        block = malloc(sizeof(pool_block) + size);
+        if (block == NULL) {
+            fatal("Could not allocate %zu bytes for a message", size);
+        }
+        block -> class = LARGE_CLASS;
+        block -> size = size;
+        block -> prev = NULL;
+        block -> next = large_blocks;
+        if (large_blocks != NULL) {
+            large_blocks -> prev = block;
+        }
+        large_blocks = block;
+        countAlloc(&stats.large, poolFootprint(size));
+    }
+    else {
+        if (free_lists[class] == NULL) {
+            refill(class);
+        }
+        block = free_lists[class];
+        free_lists[class] = block -> next;
+        block -> size = size;
+        countAlloc(&stats.classes[class], poolFootprint(size));
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&pool_mutex));
+
+    return block + 1;
+}
+
+void poolFree(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    pool_block* block = (pool_block*) ptr - 1;
+    ASSERT_ZERO(pthread_mutex_lock(&pool_mutex));
+    if (block -> class == LARGE_CLASS) {
+        if (block -> prev != NULL) {
+            block -> prev -> next = block -> next;
+        }
+        else {
+            large_blocks = block -> next;
+        }
+        if (block -> next != NULL) {
+            block -> next -> prev = block -> prev;
+        }
+        stats.large.frees++;
+        stats.large.in_use--;
+        stats.bytes -= poolFootprint(block -> size);
+        free(block);
+    }
+    else {
+        block -> next = free_lists[block -> class];
+        free_lists[block -> class] = block;
+        stats.classes[block -> class].frees++;
+        stats.classes[block -> class].in_use--;
+        stats.bytes -= poolFootprint(block -> size);
+    }
+    ASSERT_ZERO(pthread_mutex_unlock(&pool_mutex));
+}
+
+void poolStats(pool_stats* result) {
+    ASSERT_ZERO(pthread_mutex_lock(&pool_mutex));
+    *result = stats;
+    ASSERT_ZERO(pthread_mutex_unlock(&pool_mutex));
+}
+
+void poolDestroy() {
+    while (slabs != NULL) {
+        pool_slab* next = slabs -> next;
+        free(slabs);
+        slabs = next;
+    }
+
+    while (large_blocks != NULL) {
+        pool_block* next = large_blocks -> next;
+        free(large_blocks);
+        large_blocks = next;
+    }
+
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        free_lists[i] = NULL;
+    }
+    ASSERT_ZERO(pthread_mutex_destroy(&pool_mutex));
+}
@@ -0,0 +1,51 @@
+/**
+ * This file is for declarations of the memory pool used by MIMPI library
+ * for message descriptors and buffered payloads.
+ * */
+
+#ifndef MIMPI_POOL_H
+#define MIMPI_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Number of fixed block sizes; requests above the largest one are "large". */
+#define POOL_CLASSES 8
+
+/* Counters of a single size class (or of large blocks). */
+typedef struct {
+    size_t block_size;
+    uint64_t allocs;
+    uint64_t frees;
+    size_t in_use;
+    size_t peak;
+    size_t slabs;
+} pool_class_stats;
+
+/* Bytes count whole blocks, headers included, as poolFootprint does. */
+typedef struct {
+    pool_class_stats classes[POOL_CLASSES];
+    pool_class_stats large;
+    size_t bytes;
+    size_t peak_bytes;
+} pool_stats;
+
+/* Prepares the pool of the calling rank. Called in MIMPI_Init. */
+void poolInit();
+
+/* Bytes a block of size bytes takes from the pool, header included. */
+size_t poolFootprint(size_t size);
+
+/* Returns a block of at least size bytes, aligned like malloc. */
+void* poolAlloc(size_t size);
+
+/* Returns a block obtained from poolAlloc to the pool. */
+void poolFree(void* ptr);
+
+/* Copies current counters of the pool into stats. */
+void poolStats(pool_stats* stats);
+
+/* Releases every block and slab at once, whether freed or not. */
+void poolDestroy();
+
+#endif // MIMPI_POOL_H
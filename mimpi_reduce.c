@@ -0,0 +1,292 @@
+/**
+ * This file is for implementation of the kernels combining vectors in
+ * MIMPI_Reduce.
+ *
+ * Vector kernels process as many whole registers as fit and leave the
+ * rest to the scalar kernel. x86 has no multiplication of bytes, so PROD
+ * multiplies even and odd bytes as 16-bit lanes and keeps the low halves.
+ *
+ * Kernels of wider datatypes are instances of a single macro. Signed
+ * integers are added and multiplied as unsigned ones, so that they wrap
+ * around instead of overflowing.
+ * */
+
+#include "mimpi_reduce.h"
+#include "mimpi_common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define REDUCE_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*reduce_kernel)(uint8_t*, const uint8_t*, size_t);
+
+static const char* names[REDUCE_ISA_COUNT] = 
+    {"scalar", "sse2", "avx2", "avx512"};
+
+static reduce_isa selected = REDUCE_SCALAR;
+
+/************************ SCALAR KERNELS ************************/
+static void scalarMax(uint8_t* acc, const uint8_t* other, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (other[i] > acc[i]) {
+            acc[i] = other[i];
+        }
+    }
+}
+
+static void scalarMin(uint8_t* acc, const uint8_t* other, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (other[i] < acc[i]) {
+            acc[i] = other[i];
+        }
+    }
+}
+
+static void scalarSum(uint8_t* acc, const uint8_t* other, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        acc[i] += other[i];
+    }
+}
+
+static void scalarProd(uint8_t* acc, const uint8_t* other, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        acc[i] *= other[i];
+    }
+}
+
+#ifdef REDUCE_X86
+/************************ VECTOR KERNELS ************************/
+/*
+    Defines the kernel isa##Op from a function combining two registers of
+    type vec. The register functions only exist for a target, so they
+    must be marked with it just like the kernel.
+*/
+#define VECTOR_KERNEL(isa, Op, target_isa, vec, load, store, combine) \
+    static __attribute__((target(target_isa))) void \
+    isa##Op(uint8_t* acc, const uint8_t* other, size_t count) { \
+        size_t i = 0; \
+        for (; i + sizeof(vec) <= count; i += sizeof(vec)) { \
+            vec a = load((const vec*) (acc + i)); \
+            vec b = load((const vec*) (other + i)); \
+            store((vec*) (acc + i), combine(a, b)); \
+        } \
+        scalar##Op(acc + i, other + i, count - i); \
+    }
+
+static __attribute__((target("sse2"))) __m128i sse2Mul(__m128i a, __m128i b) {
+    __m128i even = _mm_mullo_epi16(a, b);
+    __m128i odd = _mm_mullo_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+    return _mm_or_si128(_mm_and_si128(even, _mm_set1_epi16(0xff)), 
+        _mm_slli_epi16(odd, 8));
+}
+
+VECTOR_KERNEL(sse2, Max, "sse2", __m128i, _mm_loadu_si128, _mm_storeu_si128,
+    _mm_max_epu8)
+VECTOR_KERNEL(sse2, Min, "sse2", __m128i, _mm_loadu_si128, _mm_storeu_si128,
+    _mm_min_epu8)
+VECTOR_KERNEL(sse2, Sum, "sse2", __m128i, _mm_loadu_si128, _mm_storeu_si128,
+    _mm_add_epi8)
+VECTOR_KERNEL(sse2, Prod, "sse2", __m128i, _mm_loadu_si128, _mm_storeu_si128,
+    sse2Mul)
+
+static __attribute__((target("avx2"))) __m256i avx2Mul(__m256i a, __m256i b) {
+    __m256i even = _mm256_mullo_epi16(a, b);
+    __m256i odd = _mm256_mullo_epi16(_mm256_srli_epi16(a, 8), 
+        _mm256_srli_epi16(b, 8));
+    return _mm256_or_si256(_mm256_and_si256(even, _mm256_set1_epi16(0xff)), 
+        _mm256_slli_epi16(odd, 8));
+}
+
+VECTOR_KERNEL(avx2, Max, "avx2", __m256i, _mm256_loadu_si256, 
+    _mm256_storeu_si256, _mm256_max_epu8)
+VECTOR_KERNEL(avx2, Min, "avx2", __m256i, _mm256_loadu_si256, 
+    _mm256_storeu_si256, _mm256_min_epu8)
+VECTOR_KERNEL(avx2, Sum, "avx2", __m256i, _mm256_loadu_si256, 
+    _mm256_storeu_si256, _mm256_add_epi8)
+VECTOR_KERNEL(avx2, Prod, "avx2", __m256i, _mm256_loadu_si256, 
+    _mm256_storeu_si256, avx2Mul)
+
+/* AVX-512F has no byte operations, they come with AVX-512BW. */
+static __attribute__((target("avx512bw"))) __m512i avx512Load(
+    const __m512i* from) {
+    return _mm512_loadu_si512(from);
+}
+
+static __attribute__((target("avx512bw"))) void avx512Store(
+    __m512i* to, __m512i value) {
+    _mm512_storeu_si512(to, value);
+}
+
+static __attribute__((target("avx512bw"))) __m512i avx512Mul(
+    __m512i a, __m512i b) {
+    __m512i even = _mm512_mullo_epi16(a, b);
+    __m512i odd = _mm512_mullo_epi16(_mm512_srli_epi16(a, 8), 
+        _mm512_srli_epi16(b, 8));
+    return _mm512_or_si512(_mm512_and_si512(even, _mm512_set1_epi16(0xff)), 
+        _mm512_slli_epi16(odd, 8));
+}
+
+VECTOR_KERNEL(avx512, Max, "avx512bw", __m512i, avx512Load, avx512Store, 
+    _mm512_max_epu8)
+VECTOR_KERNEL(avx512, Min, "avx512bw", __m512i, avx512Load, avx512Store, 
+    _mm512_min_epu8)
+VECTOR_KERNEL(avx512, Sum, "avx512bw", __m512i, avx512Load, avx512Store, 
+    _mm512_add_epi8)
+VECTOR_KERNEL(avx512, Prod, "avx512bw", __m512i, avx512Load, avx512Store, 
+    avx512Mul)
+#endif
+
+/* Kernels of every instruction set, in the order of MIMPI_Op. */
+static const reduce_kernel kernels[REDUCE_ISA_COUNT][4] = {
+    [REDUCE_SCALAR] = {scalarMax, scalarMin, scalarSum, scalarProd},
+#ifdef REDUCE_X86
+    [REDUCE_SSE2] = {sse2Max, sse2Min, sse2Sum, sse2Prod},
+    [REDUCE_AVX2] = {avx2Max, avx2Min, avx2Sum, avx2Prod},
+    [REDUCE_AVX512] = {avx512Max, avx512Min, avx512Sum, avx512Prod},
+#endif
+};
+
+/************************ TYPED KERNELS ************************/
+/* Defines the kernels of type under prefix name; arith wraps around. */
+#define TYPED_KERNELS(name, type, arith) \
+    static void name##Max(uint8_t* acc, const uint8_t* other, size_t count) { \
+        type* a = (type*) acc; \
+        const type* b = (const type*) other; \
+        for (size_t i = 0; i < count; i++) { \
+            if (b[i] > a[i]) { \
+                a[i] = b[i]; \
+            } \
+        } \
+    } \
+    static void name##Min(uint8_t* acc, const uint8_t* other, size_t count) { \
+        type* a = (type*) acc; \
+        const type* b = (const type*) other; \
+        for (size_t i = 0; i < count; i++) { \
+            if (b[i] < a[i]) { \
+                a[i] = b[i]; \
+            } \
+        } \
+    } \
+    static void name##Sum(uint8_t* acc, const uint8_t* other, size_t count) { \
+        type* a = (type*) acc; \
+        const type* b = (const type*) other; \
+        for (size_t i = 0; i < count; i++) { \
+            a[i] = (type) ((arith) a[i] + (arith) b[i]); \
+        } \
+    } \
+    static void name##Prod(uint8_t* acc, const uint8_t* other, size_t count) { \
+        type* a = (type*) acc; \
+        const type* b = (const type*) other; \
+        for (size_t i = 0; i < count; i++) { \
+            a[i] = (type) ((arith) a[i] * (arith) b[i]); \
+        } \
+    }
+
+TYPED_KERNELS(int32, int32_t, uint32_t)
+TYPED_KERNELS(int64, int64_t, uint64_t)
+TYPED_KERNELS(uint64, uint64_t, uint64_t)
+TYPED_KERNELS(float, float, float)
+TYPED_KERNELS(double, double, double)
+
+/* Kernels of every datatype but bytes, in the order of MIMPI_Op. */
+static const reduce_kernel typed_kernels[REDUCE_TYPES][4] = {
+    [MIMPI_INT32] = {int32Max, int32Min, int32Sum, int32Prod},
+    [MIMPI_INT64] = {int64Max, int64Min, int64Sum, int64Prod},
+    [MIMPI_UINT64] = {uint64Max, uint64Min, uint64Sum, uint64Prod},
+    [MIMPI_FLOAT] = {floatMax, floatMin, floatSum, floatProd},
+    [MIMPI_DOUBLE] = {doubleMax, doubleMin, doubleSum, doubleProd},
+};
+
+static const int widths[REDUCE_TYPES] = {
+    [MIMPI_UINT8] = sizeof(uint8_t),
+    [MIMPI_INT32] = sizeof(int32_t),
+    [MIMPI_INT64] = sizeof(int64_t),
+    [MIMPI_UINT64] = sizeof(uint64_t),
+    [MIMPI_FLOAT] = sizeof(float),
+    [MIMPI_DOUBLE] = sizeof(double),
+};
+
+/************************ DISPATCH ************************/
+bool reduceSupported(reduce_isa isa) {
+    switch (isa) {
+    case REDUCE_SCALAR:
+        return true;
+#ifdef REDUCE_X86
+    case REDUCE_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case REDUCE_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case REDUCE_AVX512:
+        return __builtin_cpu_supports("avx512bw");
+#endif
+    default:
+        return false;
+    }
+}
+
+void reduceInit() {
+#ifdef REDUCE_X86
+    __builtin_cpu_init();
+#endif
+
+    const char* name = getenv(REDUCE_ISA_VAR);
+    if (name != NULL) {
+        for (int isa = 0; isa < REDUCE_ISA_COUNT; isa++) {
+            if (strcmp(name, names[isa]) == 0) {
+                if (!reduceSupported(isa)) {
+                    fatal("%s=%s is not supported by this CPU", 
+                        REDUCE_ISA_VAR, name);
+                }
+                selected = isa;
+                return;
+            }
+        }
+        fatal("Unknown %s=%s (expected scalar, sse2, avx2 or avx512)", 
+            REDUCE_ISA_VAR, name);
+    }
+
+    selected = REDUCE_SCALAR;
+    for (int isa = REDUCE_SCALAR + 1; isa < REDUCE_ISA_COUNT; isa++) {
+        if (reduceSupported(isa)) {
+            selected = isa;
+        }
+    }
+}
+
+void reduceSelect(reduce_isa isa) {
+    if (!reduceSupported(isa)) {
+        fatal("Kernels %s are not supported by this CPU", names[isa]);
+    }
+    selected = isa;
+}
+
+reduce_isa reduceSelected() {
+    return selected;
+}
+
+const char* reduceName(reduce_isa isa) {
+    return names[isa];
+}
+
+bool reduceValid(MIMPI_Datatype type, MIMPI_Op op) {
+    return (int) type >= MIMPI_UINT8 && (int) type <= MIMPI_DOUBLE && 
+        (int) op >= MIMPI_MAX && (int) op <= MIMPI_PROD;
+}
+
+int reduceWidth(MIMPI_Datatype type) {
+    return widths[type];
+}
+
+void reduceInto(uint8_t* acc, const uint8_t* other, size_t count, 
+    MIMPI_Datatype type, MIMPI_Op op) {
+    if (type == MIMPI_UINT8) {
+        kernels[selected][op](acc, other, count);
+    }
+    else {
+        typed_kernels[type][op](acc, other, count);
+    }
+}
@@ -0,0 +1,60 @@
+/**
+ * This file is for declarations of the kernels combining vectors in
+ * MIMPI_Reduce. Every operation on bytes has a scalar kernel and, on x86,
+ * kernels using SSE2, AVX2 and AVX-512, of which the widest one supported
+ * by the CPU is chosen when the library is initialised. Other datatypes
+ * have one kernel per operation.
+ * */
+
+#ifndef MIMPI_REDUCE_H
+#define MIMPI_REDUCE_H
+
+#include "mimpi.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Name of the environment variable forcing a narrower instruction set. */
+#define REDUCE_ISA_VAR "MIMPI_REDUCE_ISA"
+
+typedef enum {
+    REDUCE_SCALAR,
+    REDUCE_SSE2,
+    REDUCE_AVX2,
+    REDUCE_AVX512,
+    REDUCE_ISA_COUNT,
+} reduce_isa;
+
+/*
+    Chooses the widest instruction set supported by the CPU, or the one
+    named by REDUCE_ISA_VAR ("scalar", "sse2", "avx2" or "avx512").
+    Called in MIMPI_Init.
+*/
+void reduceInit();
+
+/* True if the kernels of an instruction set can run on this CPU. */
+bool reduceSupported(reduce_isa isa);
+
+/* Switches to the kernels of a supported instruction set. */
+void reduceSelect(reduce_isa isa);
+
+reduce_isa reduceSelected();
+
+/* Name of an instruction set, as accepted in REDUCE_ISA_VAR. */
+const char* reduceName(reduce_isa isa);
+
+/* Number of datatypes, the last one of MIMPI_Datatype being double. */
+#define REDUCE_TYPES (MIMPI_DOUBLE + 1)
+
+/* True if both are values of their enums, which kernels are chosen by. */
+bool reduceValid(MIMPI_Datatype type, MIMPI_Op op);
+
+/* Size in bytes of a single element of a datatype. */
+int reduceWidth(MIMPI_Datatype type);
+
+/* Combines count elements of other into acc, element by element. */
+void reduceInto(uint8_t* acc, const uint8_t* other, size_t count, 
+    MIMPI_Datatype type, MIMPI_Op op);
+
+#endif // MIMPI_REDUCE_H
@@ -0,0 +1,386 @@
+/**
+ * This file is for implementation of event tracing and of the converter
+ * of trace files into a Chrome trace.
+ * */
+
+#include "mimpi_trace.h"
+#include "mimpi_common.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_TRACE_EVENTS (64 * 1024)
+
+/*
+    Events of a single thread. Only the owner writes to it, so recording needs
+    no lock; it is read after every other thread has been joined.
+*/
+typedef struct {
+    char name[TRACE_NAME_SIZE];
+    uint64_t head;
+    trace_event events[];
+} trace_ring;
+
+bool trace_on = false;
+
+static char* trace_prefix;
+static int trace_rank;
+static int trace_world_size;
+/* Always a power of two. */
+static uint64_t ring_capacity;
+static trace_ring* rings[TRACE_THREADS];
+static atomic_int ring_count;
+static __thread trace_ring* my_ring;
+static __thread bool ringless;
+
+static const char* const kind_names[TRACE_KINDS] = {
+    [TRACE_SEND] = "MIMPI_Send",
+    [TRACE_RECV] = "MIMPI_Recv",
+    [TRACE_ISEND] = "MIMPI_Isend",
+    [TRACE_IRECV] = "MIMPI_Irecv",
+    [TRACE_WAIT] = "MIMPI_Wait",
+    [TRACE_WAITALL] = "MIMPI_Waitall",
+    [TRACE_WAITANY] = "MIMPI_Waitany",
+    [TRACE_BARRIER] = "MIMPI_Barrier",
+    [TRACE_BCAST] = "MIMPI_Bcast",
+    [TRACE_REDUCE] = "MIMPI_Reduce",
+    [TRACE_ALLREDUCE] = "MIMPI_Allreduce",
+    [TRACE_GATHER] = "MIMPI_Gather",
+    [TRACE_ALLGATHER] = "MIMPI_Allgather",
+    [TRACE_SCATTER] = "MIMPI_Scatter",
+    [TRACE_ALLTOALL] = "MIMPI_Alltoall",
+    [TRACE_COMM_SPLIT] = "MIMPI_Comm_split",
+    [TRACE_ARRIVAL] = "arrival",
+    [TRACE_ANNOUNCEMENT] = "announcement",
+    [TRACE_PAYLOAD] = "payload",
+};
+
+void traceInit(int rank, int world_size) {
+    const char* prefix = getenv(TRACE_VAR);
+    if (prefix == NULL || *prefix == '\0') {
+        return;
+    }
+
+    uint64_t events = DEFAULT_TRACE_EVENTS;
+    const char* text = getenv(TRACE_EVENTS_VAR);
+    if (text != NULL) {
+        char* end;
+        events = strtoull(text, &end, 10);
+        if (*text == '\0' || *end != '\0' || events == 0) {
+            fatal("%s=%s is not a positive number", TRACE_EVENTS_VAR, text);
+        }
+    }
+    ring_capacity = 1;
+    while (ring_capacity < events) {
+        ring_capacity *= 2;
+    }
+
+    trace_prefix = strdup(prefix);
+    if (trace_prefix == NULL) {
+        fatal("Could not copy %s", TRACE_VAR);
+    }
+    trace_rank = rank;
+    trace_world_size = world_size;
+    atomic_store(&ring_count, 0);
+    trace_on = true;
+}
+
+void traceThread(const char* name) {
+    if (!trace_on || my_ring != NULL || ringless) {
+        return;
+    }
+
+    int index = atomic_fetch_add(&ring_count, 1);
+    if (index >= TRACE_THREADS) {
+        ringless = true;
+        return;
+    }
+
+    trace_ring* ring = malloc(sizeof(trace_ring) +
+        ring_capacity * sizeof(trace_event));
+    if (ring == NULL) {
+        fatal("Could not allocate a trace ring of %llu events",
+            (unsigned long long) ring_capacity);
+    }
+    memset(ring -> name, 0, TRACE_NAME_SIZE);
+    strncpy(ring -> name, name, TRACE_NAME_SIZE - 1);
+    ring -> head = 0;
+    rings[index] = ring;
+    my_ring = ring;
+}
+
+void traceRecord(trace_kind kind, trace_phase phase, int peer, int tag,
+    size_t bytes, int result) {
+    if (my_ring == NULL) {
+        traceThread("application");
+        if (my_ring == NULL) {
+            return;
+        }
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    trace_event* event =
+        &my_ring -> events[my_ring -> head & (ring_capacity - 1)];
+    event -> time = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+    event -> bytes = bytes;
+    event -> peer = peer;
+    event -> tag = tag;
+    event -> kind = kind;
+    event -> phase = phase;
+    event -> result = result;
+    event -> reserved = 0;
+    my_ring -> head++;
+}
+
+static void writeAll(FILE* file, const void* data, size_t size,
+    size_t count, const char* path) {
+    if (count > 0 && fwrite(data, size, count, file) != count) {
+        syserr("Could not write trace %s", path);
+    }
+}
+
+void traceFinish() {
+    if (!trace_on) {
+        return;
+    }
+    trace_on = false;
+
+    char path[strlen(trace_prefix) + 16];
+    sprintf(path, "%s.%d", trace_prefix, trace_rank);
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        syserr("Could not open trace %s", path);
+    }
+
+    int threads = atomic_load(&ring_count);
+    if (threads > TRACE_THREADS) {
+        threads = TRACE_THREADS;
+    }
+    trace_file_header header = {
+        .magic = TRACE_MAGIC,
+        .version = TRACE_VERSION,
+        .rank = trace_rank,
+        .world_size = trace_world_size,
+        .threads = threads,
+    };
+    writeAll(file, &header, sizeof(header), 1, path);
+
+    for (int i = 0; i < threads; i++) {
+        trace_ring* ring = rings[i];
+        uint64_t kept =
+            ring -> head < ring_capacity ? ring -> head : ring_capacity;
+        trace_thread_header thread = {
+            .events = kept,
+            .dropped = ring -> head - kept,
+        };
+        memcpy(thread.name, ring -> name, TRACE_NAME_SIZE);
+        writeAll(file, &thread, sizeof(thread), 1, path);
+
+        // The oldest event kept sits right after the newest one.
+        uint64_t first = (ring -> head - kept) & (ring_capacity - 1);
+        uint64_t tail = kept < ring_capacity - first ?
+            kept : ring_capacity - first;
+        writeAll(file, ring -> events + first, sizeof(trace_event), tail,
+            path);
+        writeAll(file, ring -> events, sizeof(trace_event), kept - tail,
+            path);
+
+        free(ring);
+        rings[i] = NULL;
+    }
+    if (fclose(file) != 0) {
+        syserr("Could not write trace %s", path);
+    }
+
+    free(trace_prefix);
+    trace_prefix = NULL;
+}
+
+/************************ CONVERTER ************************/
+static bool readHeader(FILE* file, const char* path,
+    trace_file_header* header) {
+    if (fread(header, sizeof(*header), 1, file) != 1 ||
+        header -> magic != TRACE_MAGIC) {
+        fprintf(stderr, "%s is not a MIMPI trace\n", path);
+        return false;
+    }
+    if (header -> version != TRACE_VERSION) {
+        fprintf(stderr, "%s has trace version %u instead of %u\n", path,
+            header -> version, TRACE_VERSION);
+        return false;
+    }
+    return true;
+}
+
+static bool truncated(const char* path) {
+    fprintf(stderr, "%s is truncated\n", path);
+    return false;
+}
+
+/* Lowers *start to the earliest event of the file. */
+static bool findStart(FILE* file, const char* path, uint64_t* start) {
+    trace_file_header header;
+    if (!readHeader(file, path, &header)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < header.threads; i++) {
+        trace_thread_header thread;
+        if (fread(&thread, sizeof(thread), 1, file) != 1) {
+            return truncated(path);
+        }
+        if (thread.events == 0) {
+            continue;
+        }
+
+        trace_event event;
+        if (fread(&event, sizeof(event), 1, file) != 1 ||
+            fseek(file, (thread.events - 1) * sizeof(event), SEEK_CUR) != 0) {
+            return truncated(path);
+        }
+        if (event.time < *start) {
+            *start = event.time;
+        }
+    }
+    return true;
+}
+
+static bool first_entry;
+
+/* Separates entries of the traceEvents array. */
+static void beginEntry(FILE* out) {
+    fprintf(out, first_entry ? "\n" : ",\n");
+    first_entry = false;
+}
+
+static bool hasTag(trace_kind kind) {
+    return kind <= TRACE_IRECV || kind == TRACE_ARRIVAL ||
+        kind == TRACE_ANNOUNCEMENT;
+}
+
+static void writeEvent(FILE* out, const trace_event* event, int rank,
+    int tid, uint64_t start) {
+    const char* name = event -> kind < TRACE_KINDS ?
+        kind_names[event -> kind] : "unknown";
+    double ts = (event -> time - start) / 1000.0;
+
+    if (event -> phase == TRACE_END) {
+        beginEntry(out);
+        fprintf(out, "{\"name\":\"%s\",\"ph\":\"E\",\"ts\":%.3f,"
+            "\"pid\":%d,\"tid\":%d,\"args\":{\"result\":%d}}", name, ts, rank,
+            tid, event -> result);
+        return;
+    }
+
+    beginEntry(out);
+    fprintf(out, "{\"name\":\"%s\",\"cat\":\"mimpi\",\"ph\":\"%s\","
+        "\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"bytes\":%llu", name,
+        event -> phase == TRACE_BEGIN ? "B" : "i\",\"s\":\"t", ts, rank, tid,
+        (unsigned long long) event -> bytes);
+    if (event -> peer >= 0) {
+        fprintf(out, ",\"peer\":%d", event -> peer);
+    }
+    if (hasTag(event -> kind)) {
+        fprintf(out, ",\"tag\":%d", event -> tag);
+    }
+    fprintf(out, "}}");
+}
+
+/* Appends all events of a file, with ranks as processes. */
+static bool convert(FILE* file, const char* path, FILE* out,
+    uint64_t start) {
+    trace_file_header header;
+    if (!readHeader(file, path, &header)) {
+        return false;
+    }
+    beginEntry(out);
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+        "\"args\":{\"name\":\"rank %d of %d\"}}", header.rank, header.rank,
+        header.world_size);
+    beginEntry(out);
+    fprintf(out, "{\"name\":\"process_sort_index\",\"ph\":\"M\","
+        "\"pid\":%d,\"args\":{\"sort_index\":%d}}", header.rank, header.rank);
+
+    for (uint32_t i = 0; i < header.threads; i++) {
+        trace_thread_header thread;
+        if (fread(&thread, sizeof(thread), 1, file) != 1) {
+            return truncated(path);
+        }
+        thread.name[TRACE_NAME_SIZE - 1] = '\0';
+        int tid = i + 1;
+        beginEntry(out);
+        fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+            "\"tid\":%d,\"args\":{\"name\":\"%s\"}}", header.rank, tid,
+            thread.name);
+        if (thread.dropped > 0) {
+            fprintf(stderr, "%s: thread %s dropped %llu oldest events\n",
+                path, thread.name, (unsigned long long) thread.dropped);
+        }
+
+        // Ends whose beginning was dropped would close unrelated slices.
+        uint64_t open = 0;
+        for (uint64_t e = 0; e < thread.events; e++) {
+            trace_event event;
+            if (fread(&event, sizeof(event), 1, file) != 1) {
+                return truncated(path);
+            }
+            if (event.phase == TRACE_BEGIN) {
+                open++;
+            }
+            else if (event.phase == TRACE_END) {
+                if (open == 0) {
+                    continue;
+                }
+                open--;
+            }
+            writeEvent(out, &event, header.rank, tid, start);
+        }
+    }
+    return true;
+}
+
+bool traceToJson(const char* output, char** files, int count) {
+    uint64_t start = UINT64_MAX;
+    for (int i = 0; i < count; i++) {
+        FILE* file = fopen(files[i], "rb");
+        if (file == NULL) {
+            perror(files[i]);
+            return false;
+        }
+        bool ok = findStart(file, files[i], &start);
+        fclose(file);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    FILE* out = fopen(output, "w");
+    if (out == NULL) {
+        perror(output);
+        return false;
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    first_entry = true;
+
+    bool ok = true;
+    for (int i = 0; i < count && ok; i++) {
+        FILE* file = fopen(files[i], "rb");
+        if (file == NULL) {
+            perror(files[i]);
+            ok = false;
+            break;
+        }
+        ok = convert(file, files[i], out, start);
+        fclose(file);
+    }
+    fprintf(out, "\n]}\n");
+    if (fclose(out) != 0) {
+        perror(output);
+        ok = false;
+    }
+    return ok;
+}
@@ -0,0 +1,127 @@
+/**
+ * This file is for declarations of event tracing. If TRACE_VAR names a path
+ * prefix, every thread of a rank records events into a ring buffer of its
+ * own and MIMPI_Finalize writes all of them to "<prefix>.<rank>". Such files
+ * of all ranks are merged into a single Chrome trace (JSON, readable by
+ * chrome://tracing and Perfetto) by "mimpirun --trace-json".
+ *
+ * A file starts with a trace_file_header. Each thread follows with
+ * a trace_thread_header and then its events, oldest first. Timestamps come
+ * from CLOCK_MONOTONIC, which all ranks of a machine share.
+ * */
+
+#ifndef MIMPI_TRACE_H
+#define MIMPI_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Name of the environment variable with the path prefix of trace files. */
+#define TRACE_VAR "MIMPI_TRACE"
+/* Name of the environment variable with the ring size in events. */
+#define TRACE_EVENTS_VAR "MIMPI_TRACE_EVENTS"
+
+#define TRACE_MAGIC 0x45434152544d494dULL // "MIMTRACE"
+#define TRACE_VERSION 1
+/* Most threads of a rank that get a ring buffer. */
+#define TRACE_THREADS 16
+#define TRACE_NAME_SIZE 24
+
+typedef enum {
+    TRACE_SEND,
+    TRACE_RECV,
+    TRACE_ISEND,
+    TRACE_IRECV,
+    TRACE_WAIT,
+    TRACE_WAITALL,
+    TRACE_WAITANY,
+    TRACE_BARRIER,
+    TRACE_BCAST,
+    TRACE_REDUCE,
+    TRACE_ALLREDUCE,
+    TRACE_GATHER,
+    TRACE_ALLGATHER,
+    TRACE_SCATTER,
+    TRACE_ALLTOALL,
+    TRACE_COMM_SPLIT,
+    // Recorded by the progress engine and the writer.
+    TRACE_ARRIVAL,
+    TRACE_ANNOUNCEMENT,
+    TRACE_PAYLOAD,
+    TRACE_KINDS,
+} trace_kind;
+
+typedef enum {
+    TRACE_BEGIN,
+    TRACE_END,
+    TRACE_INSTANT,
+} trace_phase;
+
+/*
+    A single event. Peers are world ranks (-1 if there is none) and bytes
+    count the data of a rank, not of the whole collective.
+*/
+typedef struct {
+    uint64_t time;
+    uint64_t bytes;
+    int32_t peer;
+    int32_t tag;
+    uint16_t kind;
+    uint8_t phase;
+    int8_t result;
+    uint32_t reserved;
+} trace_event;
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    int32_t rank;
+    int32_t world_size;
+    uint32_t threads;
+} trace_file_header;
+
+typedef struct {
+    char name[TRACE_NAME_SIZE];
+    uint64_t events;
+    uint64_t dropped;
+} trace_thread_header;
+
+/* Whether events are recorded at all. Only read through TRACE. */
+extern bool trace_on;
+
+/*
+    Records an event of the calling thread if tracing is on, which costs
+    a single branch otherwise.
+*/
+#define TRACE(kind, phase, peer, tag, bytes, result)                       \
+    do {                                                                   \
+        if (__builtin_expect(trace_on, false))                             \
+            traceRecord((kind), (phase), (peer), (tag), (bytes), (result));\
+    } while(0)
+
+/* Reads TRACE_VAR and TRACE_EVENTS_VAR. Called in MIMPI_Init. */
+void traceInit(int rank, int world_size);
+
+/*
+    Gives the calling thread a ring buffer with the name shown in the trace.
+    Threads that record without calling it are named "application".
+*/
+void traceThread(const char* name);
+
+void traceRecord(trace_kind kind, trace_phase phase, int peer, int tag,
+    size_t bytes, int result);
+
+/*
+    Writes the trace file of the rank and releases all ring buffers.
+    Called in MIMPI_Finalize once no other thread records.
+*/
+void traceFinish();
+
+/*
+    Merges trace files of ranks into a Chrome trace at output.
+    Returns false (after printing why) if some file could not be read.
+*/
+bool traceToJson(const char* output, char** files, int count);
+
+#endif // MIMPI_TRACE_H
@@ -0,0 +1,259 @@
+/**
+ * This file is for implementation of the transports carrying point-to-point
+ * traffic between ranks.
+ * */
+
+#include "mimpi_transport.h"
+#include "channel.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Largest write to a channel that is still atomic. */
+#define CHUNK_SIZE 512
+
+/*
+    Every ordered pair of ranks owns one single-producer single-consumer ring.
+    Head and tail count bytes ever consumed and produced, so the ring is
+    full when they differ by its capacity. They live on separate cache lines
+    because they are written by different processes.
+*/
+typedef struct {
+    _Alignas(64) _Atomic uint64_t head;
+    _Alignas(64) _Atomic uint64_t tail;
+} ring_header;
+
+/*
+    Records sent through the pipe when the shared-memory transport is used.
+    A record announces how many bytes to take from the ring of the pair,
+    or, with DOORBELL_INLINE set, how many bytes follow it in the pipe.
+*/
+typedef uint32_t doorbell;
+#define DOORBELL_INLINE 0x80000000u
+
+static transport_kind kind = TRANSPORT_PIPE;
+static fd_table* table;
+static size_t ring_size;
+static char* region;
+static size_t region_size;
+
+/* Bytes of the current record of each source that are yet to be received. */
+static size_t* ring_pending;
+static size_t* inline_pending;
+
+transport_kind transportSelected() {
+    const char* name = getenv(TRANSPORT_VAR);
+    if (name == NULL || strcmp(name, "pipe") == 0) {
+        return TRANSPORT_PIPE;
+    }
+    if (strcmp(name, "shm") == 0) {
+        return TRANSPORT_SHM;
+    }
+    fatal("Unknown %s=%s (expected pipe or shm)", TRANSPORT_VAR, name);
+}
+
+static size_t ringSize() {
+    const char* value = getenv(RING_SIZE_VAR);
+    if (value == NULL) {
+        return RING_SIZE_DEFAULT;
+    }
+
+    char* end;
+    unsigned long long size = strtoull(value, &end, 10);
+    if (*value == '\0' || *end != '\0' ||
+        size < RING_SIZE_MIN || size > RING_SIZE_MAX) {
+        fatal("%s must be a number of bytes between %d and %d",
+            RING_SIZE_VAR, RING_SIZE_MIN, RING_SIZE_MAX);
+    }
+    return size;
+}
+
+static size_t ringStride(size_t size) {
+    return sizeof(ring_header) + size;
+}
+
+size_t transportRegionSize(int size) {
+    return (size_t) size * size * ringStride(ringSize());
+}
+
+static ring_header* ringOf(int from, int to) {
+    size_t index = (size_t) from * table -> size + to;
+    return (ring_header*) (region + index * ringStride(ring_size));
+}
+
+static char* ringData(ring_header* ring) {
+    return (char*) (ring + 1);
+}
+
+void transportInit(fd_table* fds) {
+    table = fds;
+    kind = fds -> transport;
+    if (kind == TRANSPORT_PIPE) {
+        return;
+    }
+
+    ring_size = ringSize();
+    region_size = transportRegionSize(fds -> size);
+
+    struct stat info;
+    ASSERT_SYS_OK(fstat(FD_SHM(fds), &info));
+    if (info.st_size != region_size) {
+        fatal("Shared region has %lld bytes instead of %zu, is %s the same as "
+            "for mimpirun?", (long long) info.st_size, region_size,
+            RING_SIZE_VAR);
+    }
+
+    region = mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        FD_SHM(fds), 0);
+    if (region == MAP_FAILED) {
+        syserr("Could not map the shared region");
+    }
+    /* The mapping stays valid, the descriptor is not needed anymore. */
+    ASSERT_SYS_OK(close(FD_SHM(fds)));
+    FD_SHM(fds) = -1;
+
+    ring_pending = calloc(fds -> size, sizeof(size_t));
+    inline_pending = calloc(fds -> size, sizeof(size_t));
+    if (ring_pending == NULL || inline_pending == NULL) {
+        fatal("Could not allocate transport state for %d ranks", fds -> size);
+    }
+}
+
+void transportFinalize() {
+    if (kind == TRANSPORT_PIPE) {
+        return;
+    }
+
+    ASSERT_SYS_OK(munmap(region, region_size));
+    free(ring_pending);
+    free(inline_pending);
+    region = NULL;
+}
+
+static void ringWrite(ring_header* ring, uint64_t position,
+    const void* buf, size_t count) {
+    size_t offset = position % ring_size;
+    size_t first = (count > ring_size - offset) ? ring_size - offset : count;
+    memcpy(ringData(ring) + offset, buf, first);
+    memcpy(ringData(ring), (const char*) buf + first, count - first);
+}
+
+static void ringRead(ring_header* ring, uint64_t position,
+    void* buf, size_t count) {
+    size_t offset = position % ring_size;
+    size_t first = (count > ring_size - offset) ? ring_size - offset : count;
+    memcpy(buf, ringData(ring) + offset, first);
+    memcpy((char*) buf + first, ringData(ring), count - first);
+}
+
+/*
+    Copies as much as fits into the ring towards the peer and rings the
+    doorbell. Once the ring is full (the peer is behind), data goes inline
+    through the pipe, which blocks the sender the same way pipes always did.
+*/
+static ssize_t shmSend(int peer, const void* buf, size_t count) {
+    int fd = FD_OUT(table, peer);
+    ring_header* ring = ringOf(table -> rank, peer);
+    uint64_t tail = atomic_load_explicit(&ring -> tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ring -> head, memory_order_acquire);
+    size_t space = ring_size - (tail - head);
+
+    if (space > 0) {
+        size_t taken = (count > space) ? space : count;
+        ringWrite(ring, tail, buf, taken);
+        atomic_store_explicit(&ring -> tail, tail + taken, memory_order_release);
+
+        doorbell record = taken;
+        if (chsend(fd, &record, sizeof(record)) == -1) {
+            return -1;
+        }
+        return taken;
+    }
+
+    char frame[CHUNK_SIZE];
+    size_t taken = (count > CHUNK_SIZE - sizeof(doorbell)) ?
+        CHUNK_SIZE - sizeof(doorbell) : count;
+    doorbell record = taken | DOORBELL_INLINE;
+    memcpy(frame, &record, sizeof(record));
+    memcpy(frame + sizeof(record), buf, taken);
+
+    if (chsend(fd, frame, sizeof(record) + taken) == -1) {
+        return -1;
+    }
+    return taken;
+}
+
+/*
+    Doorbells are written whole in a single write, so once the pipe is
+    readable the entire record is there and this read does not wait.
+*/
+static ssize_t shmRecv(int peer, void* buf, size_t count) {
+    int fd = FD_IN(table, peer);
+
+    if (ring_pending[peer] == 0 && inline_pending[peer] == 0) {
+        doorbell record;
+        size_t got = 0;
+        while (got < sizeof(record)) {
+            ssize_t ret = chrecv(fd, (char*) &record + got,
+                sizeof(record) - got);
+            if (ret <= 0) {
+                return ret;
+            }
+            got += ret;
+        }
+
+        if (record & DOORBELL_INLINE) {
+            inline_pending[peer] = record & ~DOORBELL_INLINE;
+        }
+        else {
+            ring_pending[peer] = record;
+        }
+    }
+
+    if (ring_pending[peer] > 0) {
+        ring_header* ring = ringOf(peer, table -> rank);
+        size_t taken = (count > ring_pending[peer]) ?
+            ring_pending[peer] : count;
+        uint64_t head = atomic_load_explicit(&ring -> head,
+            memory_order_relaxed);
+        ringRead(ring, head, buf, taken);
+        atomic_store_explicit(&ring -> head, head + taken,
+            memory_order_release);
+        ring_pending[peer] -= taken;
+        return taken;
+    }
+
+    size_t wanted = (count > inline_pending[peer]) ?
+        inline_pending[peer] : count;
+    ssize_t ret = chrecv(fd, buf, wanted);
+    if (ret > 0) {
+        inline_pending[peer] -= ret;
+    }
+    return ret;
+}
+
+ssize_t transportSend(int peer, const void* buf, size_t count) {
+    if (kind == TRANSPORT_SHM) {
+        return shmSend(peer, buf, count);
+    }
+    return chsend(FD_OUT(table, peer), buf,
+        (count > CHUNK_SIZE) ? CHUNK_SIZE : count);
+}
+
+ssize_t transportRecv(int peer, void* buf, size_t count) {
+    if (kind == TRANSPORT_SHM) {
+        return shmRecv(peer, buf, count);
+    }
+    return chrecv(FD_IN(table, peer), buf,
+        (count > CHUNK_SIZE) ? CHUNK_SIZE : count);
+}
+
+bool transportPending(int peer) {
+    return kind == TRANSPORT_SHM && ring_pending[peer] > 0;
+}
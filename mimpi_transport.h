@@ -0,0 +1,56 @@
+/**
+ * This file is for declarations of the transport carrying point-to-point
+ * traffic between ranks. The pipe transport passes every byte through
+ * channels; the shared-memory transport copies payloads through rings in
+ * a memory region created by mimpirun and uses the pipes only to ring
+ * a "doorbell" (or to carry data inline when a ring is full).
+ * */
+
+#ifndef MIMPI_TRANSPORT_H
+#define MIMPI_TRANSPORT_H
+
+#include "mimpi_common.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Name of the environment variable selecting the transport of a job. */
+#define TRANSPORT_VAR "MIMPI_TRANSPORT"
+/* Name of the environment variable with the capacity of a single ring. */
+#define RING_SIZE_VAR "MIMPI_SHM_RING_SIZE"
+
+#define RING_SIZE_DEFAULT (256 * 1024)
+#define RING_SIZE_MIN 4096
+#define RING_SIZE_MAX (1 << 30)
+
+/* Transport chosen by TRANSPORT_VAR ("pipe", the default, or "shm"). */
+transport_kind transportSelected();
+
+/* Bytes of the shared region needed by a job of a given size. */
+size_t transportRegionSize(int size);
+
+/* Prepares the transport of the calling rank. Called in MIMPI_Init. */
+void transportInit(fd_table* table);
+
+/* Releases what transportInit acquired. Called in MIMPI_Finalize. */
+void transportFinalize();
+
+/*
+    Sends a prefix of count bytes to a peer, just like chsend does for
+    a descriptor. Returns the number of bytes sent or -1 with errno set.
+*/
+ssize_t transportSend(int peer, const void* buf, size_t count);
+
+/*
+    Receives up to count bytes from a peer, just like chrecv does for
+    a descriptor. Returns 0 once the peer has closed its end.
+*/
+ssize_t transportRecv(int peer, void* buf, size_t count);
+
+/*
+    True if bytes from a peer are ready to be received even though its pipe
+    may not be readable (they were announced by a doorbell already read).
+*/
+bool transportPending(int peer);
+
+#endif // MIMPI_TRANSPORT_H
@@ -0,0 +1,100 @@
+/**
+ * This file is for implementation of the tuning table choosing algorithms
+ * of collectives.
+ * */
+
+#include "mimpi_tuning.h"
+#include "mimpi_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NAME_SIZE 32
+
+typedef struct {
+    char collective[NAME_SIZE];
+    char algorithm[NAME_SIZE];
+    long long ranks;
+    long long bytes;
+} tuning_rule;
+
+static tuning_rule* rules;
+static int rule_count;
+
+static bool parseLimit(const char* text, long long* limit) {
+    if (strcmp(text, "*") == 0) {
+        *limit = TUNING_ANY;
+        return true;
+    }
+
+    char* end;
+    *limit = strtoll(text, &end, 10);
+    return *text != '\0' && *end == '\0' && *limit >= 0;
+}
+
+void tuningLoad(bool (*known)(const char* collective, const char* algorithm)) {
+    const char* path = getenv(TUNING_FILE_VAR);
+    if (path == NULL) {
+        return;
+    }
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        syserr("Could not open %s=%s", TUNING_FILE_VAR, path);
+    }
+
+    int capacity = 0;
+    char line[256];
+    for (int number = 1; fgets(line, sizeof(line), file) != NULL; number++) {
+        char* first = line + strspn(line, " \t\r\n");
+        if (*first == '\0' || *first == '#') {
+            continue;
+        }
+
+        char ranks[NAME_SIZE];
+        char bytes[NAME_SIZE];
+        char extra;
+        tuning_rule rule;
+        if (sscanf(first, "%31s %31s %31s %31s %c", rule.collective, ranks, 
+            bytes, rule.algorithm, &extra) != 4 ||
+            !parseLimit(ranks, &rule.ranks) || 
+            !parseLimit(bytes, &rule.bytes)) {
+            fatal("%s:%d: expected <collective> <ranks> <bytes> <algorithm>",
+                path, number);
+        }
+        if (!known(rule.collective, rule.algorithm)) {
+            fatal("%s:%d: unknown algorithm %s of %s", path, number, 
+                rule.algorithm, rule.collective);
+        }
+
+        if (rule_count == capacity) {
+            capacity = (capacity == 0) ? 16 : 2 * capacity;
+            rules = realloc(rules, capacity * sizeof(tuning_rule));
+            if (rules == NULL) {
+                fatal("Could not allocate %d tuning rules", capacity);
+            }
+        }
+        rules[rule_count++] = rule;
+    }
+
+    fclose(file);
+}
+
+const char* tuningLookup(const char* collective, int ranks, long long bytes) {
+    for (int i = 0; i < rule_count; i++) {
+        tuning_rule* rule = &rules[i];
+        if (strcmp(rule -> collective, collective) == 0 &&
+            (rule -> ranks == TUNING_ANY || ranks <= rule -> ranks) &&
+            (rule -> bytes == TUNING_ANY || bytes <= rule -> bytes)) {
+            return rule -> algorithm;
+        }
+    }
+    return NULL;
+}
+
+void tuningFree() {
+    free(rules);
+    rules = NULL;
+    rule_count = 0;
+}
@@ -0,0 +1,41 @@
+/**
+ * This file is for declarations of the tuning table choosing algorithms
+ * of collectives. The table is a text file named by TUNING_FILE_VAR, with
+ * one rule per line:
+ *
+ *     <collective> <ranks> <bytes> <algorithm>
+ *
+ * A rule applies to calls in a world of at most <ranks> processes with
+ * messages of at most <bytes> bytes, "*" standing for no limit. The first
+ * rule that applies wins. Empty lines and lines starting with '#' are
+ * skipped. Such tables are written by "mimpirun --autotune".
+ * */
+
+#ifndef MIMPI_TUNING_H
+#define MIMPI_TUNING_H
+
+#include <stdbool.h>
+
+/* Name of the environment variable with the path of the tuning table. */
+#define TUNING_FILE_VAR "MIMPI_TUNING_FILE"
+
+/* Written for a limit of "*" in a rule. */
+#define TUNING_ANY -1
+
+/*
+    Reads the table named by TUNING_FILE_VAR, if any. Every rule is checked
+    with known, which must accept its collective and algorithm.
+    Called in MIMPI_Init.
+*/
+void tuningLoad(bool (*known)(const char* collective, const char* algorithm));
+
+/*
+    Returns the algorithm of the first rule for a call, or NULL if no rule
+    applies to it.
+*/
+const char* tuningLookup(const char* collective, int ranks, long long bytes);
+
+/* Releases the table. Called in MIMPI_Finalize. */
+void tuningFree();
+
+#endif // MIMPI_TUNING_H
@@ -2,31 +2,402 @@
  * This file is for implementation of mimpirun program.
  * */
 
+#define _GNU_SOURCE
+
+#include "mimpi.h"
 #include "mimpi_common.h"
+#include "mimpi_trace.h"
+#include "mimpi_transport.h"
+#include "mimpi_tuning.h"
 #include "channel.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 #include <libgen.h>
 
-static int pipes[16][16][2];
-static int forGroups[16][4][2];
-static int firstAndOthers[16][2][2];
+/*
+    "mimpirun --autotune <table> <n>" runs n copies of itself with
+    AUTOTUNE_RANK_FLAG, which benchmark every algorithm of every collective
+    and write the fastest ones into the tuning table.
+*/
+#define AUTOTUNE_FLAG "--autotune"
+#define AUTOTUNE_RANK_FLAG "--autotune-rank"
+
+/*
+    "mimpirun --trace-json <output> <trace files>..." merges trace files
+    written by ranks run with MIMPI_TRACE into a single Chrome trace.
+*/
+#define TRACE_JSON_FLAG "--trace-json"
+
+/* Message sizes benchmarked, each one a limit of a rule in the table. */
+static const int tune_sizes[] = {1, 256, 4096, 64 * 1024, 1024 * 1024};
+#define TUNE_SIZES (sizeof(tune_sizes) / sizeof(tune_sizes[0]))
+#define TUNE_LARGEST (1024 * 1024)
+
+/* Descriptor numbers the children expect, one table per rank. */
+static fd_table* slots;
+/*
+    Sockets over which mimpirun hands the children their descriptors. Every
+    channel is created only once all children run and both of its ends are
+    closed in mimpirun right after they are sent, so mimpirun never holds
+    more than a descriptor per rank.
+*/
+static int* controls;
+static int stage_base;
+
+/*
+    Moves a freshly created descriptor above every slot of the children tables,
+    so that dup2 in a child can never overwrite a descriptor it still needs.
+    F_DUPFD only duplicates the descriptor, it does not change its properties.
+*/
+static int stage(int fd) {
+    int moved = fcntl(fd, F_DUPFD, stage_base);
+    ASSERT_SYS_OK(moved);
+    ASSERT_SYS_OK(close(fd));
+    return moved;
+}
+
+/*
+    Sends a descriptor to a rank together with the entry of its table that
+    the descriptor belongs to. A rank that died before receiving everything
+    is skipped, mimpirun reports it once it is reaped.
+*/
+static void handOver(int rank, int* slot, int fd) {
+    int entry = slot - slots[rank].fds;
+    struct iovec iov = { .iov_base = &entry, .iov_len = sizeof(entry) };
+    char buffer[CMSG_SPACE(sizeof(int))];
+    memset(buffer, 0, sizeof(buffer));
+    struct msghdr message = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = buffer,
+        .msg_controllen = sizeof(buffer),
+    };
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header -> cmsg_level = SOL_SOCKET;
+    header -> cmsg_type = SCM_RIGHTS;
+    header -> cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &fd, sizeof(int));
+
+    // Descriptors in flight are limited per user; ranks drain them quickly.
+    while (sendmsg(controls[rank], &message, MSG_NOSIGNAL) == -1) {
+        if (errno == EPIPE) {
+            return;
+        }
+        if (errno == ETOOMANYREFS) {
+            usleep(1000);
+        }
+        else if (errno != EINTR) {
+            syserr("Could not hand a descriptor over to rank %d", rank);
+        }
+    }
+}
+
+/*
+    Receives the descriptors of a rank (in its child, before exec) and puts
+    them in place. Every slot is first taken by a copy of the socket, so
+    that a received descriptor never lands on a slot still to be filled.
+*/
+static void receiveDescriptors(int rank, int control, int expected) {
+    fd_table* table = &slots[rank];
+    for (int i = 0; i < table -> length; i++) {
+        if (table -> fds[i] != -1) {
+            ASSERT_SYS_OK(dup2(control, table -> fds[i]));
+        }
+    }
+
+    int received = 0;
+    while (true) {
+        int entry;
+        struct iovec iov = { .iov_base = &entry, .iov_len = sizeof(entry) };
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct msghdr message = {
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = buffer,
+            .msg_controllen = sizeof(buffer),
+        };
+        ssize_t got = recvmsg(control, &message, 0);
+        if (got == -1 && errno == EINTR) {
+            continue;
+        }
+        ASSERT_SYS_OK(got);
+        if (got == 0) {
+            break;
+        }
+
+        struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+        if (got != sizeof(entry) || header == NULL || 
+            header -> cmsg_type != SCM_RIGHTS || entry < 0 || 
+            entry >= table -> length || table -> fds[entry] == -1) {
+            fatal("Malformed descriptor hand-over to rank %d", rank);
+        }
+        int fd;
+        memcpy(&fd, CMSG_DATA(header), sizeof(int));
+        ASSERT_SYS_OK(dup2(fd, table -> fds[entry]));
+        ASSERT_SYS_OK(close(fd));
+        received++;
+    }
+
+    if (received != expected) {
+        fatal("Rank %d received %d of its %d descriptors", rank, received, 
+            expected);
+    }
+    ASSERT_SYS_OK(close(control));
+}
+
+static void connectRanks(int writer, int* write_slot, int reader, 
+    int* read_slot) {
+    int pipefd[2];
+    ASSERT_SYS_OK(channel(pipefd));
+    handOver(reader, read_slot, pipefd[0]);
+    handOver(writer, write_slot, pipefd[1]);
+    ASSERT_SYS_OK(close(pipefd[0]));
+    ASSERT_SYS_OK(close(pipefd[1]));
+}
+
+static void ensureDescriptorLimit(int needed) {
+    struct rlimit limit;
+    ASSERT_SYS_OK(getrlimit(RLIMIT_NOFILE, &limit));
+    if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < needed) {
+        if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < needed) {
+            fatal("mimpirun needs %d descriptors, but the hard limit is %llu",
+                needed, (unsigned long long) limit.rlim_max);
+        }
+        limit.rlim_cur = needed;
+        ASSERT_SYS_OK(setrlimit(RLIMIT_NOFILE, &limit));
+    }
+}
+
+/*
+    Creates the region holding the rings of all ordered pairs of ranks and
+    hands every rank its own descriptor of it. A fresh region is zeroed,
+    which is exactly the state of empty rings.
+*/
+static void createSharedRegion(int n) {
+    int region = memfd_create("mimpi_rings", 0);
+    ASSERT_SYS_OK(region);
+    ASSERT_SYS_OK(ftruncate(region, transportRegionSize(n)));
+
+    for (int k = 0; k < n; k++) {
+        handOver(k, &FD_SHM(&slots[k]), region);
+    }
+    ASSERT_SYS_OK(close(region));
+}
+
+static void createChannels(int n) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (i != j) {
+                connectRanks(i, &FD_OUT(&slots[i], j), 
+                    j, &FD_IN(&slots[j], i));
+            }
+        }
+    }
+
+    for (int child = 1; child < n; child++) {
+        int parent = TREE_PARENT(child);
+        int id = child - TREE_CHILD(parent, 0);
+        connectRanks(parent, &FD_CHILD_OUT(&slots[parent], id),
+            child, &FD_PARENT_IN(&slots[child]));
+        connectRanks(child, &FD_PARENT_OUT(&slots[child]),
+            parent, &FD_CHILD_IN(&slots[parent], id));
+    }
+
+    if (slots[0].transport == TRANSPORT_SHM) {
+        createSharedRegion(n);
+    }
+}
+
+static void runCollective(collective_kind collective, int bytes, 
+    u_int8_t* in, u_int8_t* out) {
+    MIMPI_Retcode ret = MIMPI_SUCCESS;
+
+    switch (collective) {
+    case COLLECTIVE_BARRIER:
+        ret = MIMPI_Barrier();
+        break;
+
+    case COLLECTIVE_BCAST:
+        ret = MIMPI_Bcast(out, bytes, 0);
+        break;
+
+    case COLLECTIVE_REDUCE:
+        ret = MIMPI_Reduce(in, out, bytes, MIMPI_SUM, 0);
+        break;
+
+    case COLLECTIVE_ALLREDUCE:
+        ret = MIMPI_Allreduce(in, out, bytes, MIMPI_SUM);
+        break;
+
+    case COLLECTIVE_ALLGATHER:
+        ret = MIMPI_Allgather(in, out, bytes);
+        break;
+
+    default:
+        break;
+    }
+
+    if (ret != MIMPI_SUCCESS) {
+        fatal("%s failed with %d while autotuning", 
+            collectiveName(collective), ret);
+    }
+}
+
+/* Seconds a single call takes on the slowest rank. */
+static double benchmark(collective_kind collective, int bytes, 
+    u_int8_t* in, u_int8_t* out) {
+    int rounds = (bytes <= 4096) ? 20 : (bytes <= 64 * 1024) ? 5 : 2;
+    struct timespec start;
+    struct timespec end;
+
+    runCollective(collective, bytes, in, out);
+    if (MIMPI_Barrier() != MIMPI_SUCCESS) {
+        fatal("Barrier failed while autotuning");
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < rounds; i++) {
+        runCollective(collective, bytes, in, out);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double mine = ((end.tv_sec - start.tv_sec) + 
+        (end.tv_nsec - start.tv_nsec) * 1e-9) / rounds;
+    double slowest;
+    if (MIMPI_Allreduce_typed(&mine, &slowest, 1, MIMPI_DOUBLE, MIMPI_MAX) != 
+        MIMPI_SUCCESS) {
+        fatal("Allreduce failed while autotuning");
+    }
+    return slowest;
+}
+
+/*
+    Body of every rank of "mimpirun --autotune". Rank 0 writes the rules,
+    with the timings of all candidates in comments. A rule covers sizes up
+    to the one benchmarked, and neighbouring rules with the same algorithm
+    are merged.
+*/
+static int autotune(const char* path) {
+    MIMPI_Init(false);
+
+    int rank = MIMPI_World_rank();
+    int size = MIMPI_World_size();
+    u_int8_t* in = calloc(TUNE_LARGEST, 1);
+    u_int8_t* out = calloc((size_t) TUNE_LARGEST * size, 1);
+    if (in == NULL || out == NULL) {
+        fatal("Could not allocate autotuning buffers");
+    }
+
+    FILE* table = NULL;
+    if (rank == 0) {
+        table = fopen(path, "w");
+        if (table == NULL) {
+            syserr("Could not open %s", path);
+        }
+        fprintf(table, "# Written by mimpirun --autotune for %d ranks.\n", 
+            size);
+        fprintf(table, "# <collective> <ranks> <bytes> <algorithm>\n");
+    }
+
+    for (int collective = 0; collective < COLLECTIVES; collective++) {
+        const char* const* algorithms = collectiveAlgorithms(collective);
+        int sizes = (collective == COLLECTIVE_BARRIER) ? 1 : TUNE_SIZES;
+        const char* best[TUNE_SIZES];
+
+        for (int i = 0; i < sizes; i++) {
+            int bytes = (collective == COLLECTIVE_BARRIER) ? 0 : tune_sizes[i];
+            double best_time = 0;
+            best[i] = NULL;
+
+            if (table != NULL) {
+                fprintf(table, "# %s %d:", collectiveName(collective), bytes);
+            }
+            for (int a = 0; algorithms[a] != NULL; a++) {
+                forceAlgorithm(collective, algorithms[a]);
+                double time = benchmark(collective, bytes, in, out);
+                if (best[i] == NULL || time < best_time) {
+                    best[i] = algorithms[a];
+                    best_time = time;
+                }
+                if (table != NULL) {
+                    fprintf(table, " %s %.6fs", algorithms[a], time);
+                }
+            }
+            forceAlgorithm(collective, NULL);
+            if (table != NULL) {
+                fprintf(table, "\n");
+            }
+        }
+
+        for (int i = 0; i < sizes && table != NULL; i++) {
+            if (i + 1 < sizes && strcmp(best[i], best[i + 1]) == 0) {
+                continue;
+            }
+            if (i + 1 == sizes) {
+                fprintf(table, "%s %d * %s\n", collectiveName(collective), 
+                    size, best[i]);
+            }
+            else {
+                fprintf(table, "%s %d %d %s\n", collectiveName(collective), 
+                    size, tune_sizes[i], best[i]);
+            }
+        }
+    }
+
+    if (table != NULL) {
+        ASSERT_ZERO(fclose(table));
+    }
+    free(in);
+    free(out);
+
+    MIMPI_Finalize();
+    return 0;
+}
 
 int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], AUTOTUNE_RANK_FLAG) == 0) {
+        return autotune(argv[2]);
+    }
+    if (argc >= 4 && strcmp(argv[1], TRACE_JSON_FLAG) == 0) {
+        return traceToJson(argv[2], argv + 3, argc - 3) ? 0 : 1;
+    }
+
     int no_args = argc;
     char** main_args = argv;
+    if (argc == 4 && strcmp(argv[1], AUTOTUNE_FLAG) == 0) {
+        /* As if called with "<n> <this program> --autotune-rank <table>". */
+        static char* autotune_args[6];
+        autotune_args[0] = argv[0];
+        autotune_args[1] = argv[3];
+        autotune_args[2] = "/proc/self/exe";
+        autotune_args[3] = AUTOTUNE_RANK_FLAG;
+        autotune_args[4] = argv[2];
+        autotune_args[5] = NULL;
+        no_args = 5;
+        main_args = autotune_args;
+        /* Tuning must not start from an old table. */
+        ASSERT_ZERO(unsetenv(TUNING_FILE_VAR));
+    }
     if (no_args < 3) {
         return -1;
     }
 
     int n = atoi(main_args[1]);
+    if (n < 1) {
+        return -1;
+    }
     char* path = main_args[2];
     int prog_args = no_args - 2;
     char* args[prog_args + 1];
@@ -35,156 +406,77 @@ int main(int argc, char **argv) {
     }
     args[prog_args] = NULL;
 
-    char* name = (char*) malloc(strlen("MIMPI_n=") + 3);
+    char* name = (char*) malloc(strlen("MIMPI_n=") + 12);
     ASSERT_SYS_OK(sprintf(name, "MIMPI_n=%d", n));
     ASSERT_ZERO(putenv(name));
 
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            if (i != j) {
-                ASSERT_SYS_OK(channel(pipes[i][j]));
-                ASSERT_SYS_OK(dup2(pipes[i][j][0], (20 * (2 * i + 1) + j)));
-                ASSERT_SYS_OK(close(pipes[i][j][0]));
-                ASSERT_SYS_OK(dup2(pipes[i][j][1], (40 * (i + 1) + j)));
-                ASSERT_SYS_OK(close(pipes[i][j][1]));
-            }
-        }
-    }
-
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < 2; j++) {
-            int me = i + 1;
-            int id = j + 1;
-            if (2 * me + j <= n) {
-                ASSERT_SYS_OK(channel(forGroups[i][j]));
-                ASSERT_SYS_OK(dup2(forGroups[i][j][0], (700 + 6 * me - 3 + id)));
-                ASSERT_SYS_OK(close(forGroups[i][j][0]));
-                ASSERT_SYS_OK(dup2(forGroups[i][j][1], (700 + 6 * (2 * me + (id - 1)))));
-                ASSERT_SYS_OK(close(forGroups[i][j][1]));
-
-                ASSERT_SYS_OK(channel(forGroups[i][j+2]));
-                ASSERT_SYS_OK(dup2(forGroups[i][j+2][0], (700 + 6 * (2 * me + j) - 3)));
-                ASSERT_SYS_OK(close(forGroups[i][j+2][0]));
-                ASSERT_SYS_OK(dup2(forGroups[i][j+2][1], (700 + 6 * me + id)));
-                ASSERT_SYS_OK(close(forGroups[i][j+2][1]));
-            }
+    slots = malloc(n * sizeof(fd_table));
+    controls = malloc(n * sizeof(int));
+    int* table_sizes = malloc(n * sizeof(int));
+    transport_kind transport = transportSelected();
+    int largest_table = 0;
+    for (int k = 0; k < n; k++) {
+        fdTableInit(&slots[k], n, k, transport);
+        table_sizes[k] = fdTableLayout(&slots[k], FD_TABLE_BASE);
+        if (table_sizes[k] > largest_table) {
+            largest_table = table_sizes[k];
         }
     }
 
-    for (int i = 1; i < n; i++) {
-        int me = i + 1;
-        ASSERT_SYS_OK(channel(firstAndOthers[i][0]));
-        ASSERT_SYS_OK(dup2(firstAndOthers[i][0][0], (900 + 4 * me + 1)));
-        ASSERT_SYS_OK(close(firstAndOthers[i][0][0]));
-        ASSERT_SYS_OK(dup2(firstAndOthers[i][0][1], (900 + 4 * me + 2)));
-        ASSERT_SYS_OK(close(firstAndOthers[i][0][1]));
-
-        ASSERT_SYS_OK(channel(firstAndOthers[i][1]));
-        ASSERT_SYS_OK(dup2(firstAndOthers[i][1][0], (900 + 4 * me + 3)));
-        ASSERT_SYS_OK(close(firstAndOthers[i][1][0]));
-        ASSERT_SYS_OK(dup2(firstAndOthers[i][1][1], (900 + 4 * me + 0)));
-        ASSERT_SYS_OK(close(firstAndOthers[i][1][1]));
-    }
+    // The tables of the children, the sockets and a pipe in flight.
+    stage_base = FD_TABLE_BASE + largest_table;
+    ensureDescriptorLimit(stage_base + n + 4);
 
     int status;
-    char* pid = (char*) malloc(strlen("MIMPI_=") + 20 + 2 + 1);
+    char* pid = (char*) malloc(strlen("MIMPI_=") + 20 + 12 + 1);
+    char* table = (char*) malloc(strlen(FD_TABLE_VAR "=,") + 24 + 1);
     for (int k = 0; k < n; k++) {
+        int pair[2];
+        ASSERT_SYS_OK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+        controls[k] = stage(pair[0]);
+        int control = stage(pair[1]);
+
         status = fork();
         if (status == 0) {
             ASSERT_SYS_OK(sprintf(pid, "MIMPI_%d=%d", getpid(), k));
             ASSERT_ZERO(putenv(pid));
-            for (int i = 0; i < n; i++) {
-                for (int j = 0; j < n; j++) {
-                    if (i != j) {
-                        if (i != k) {
-                            ASSERT_SYS_OK(close((20 * (2 * i + 1)) + j));
-                        } 
-                        
-                        if (j != k) {
-                            ASSERT_SYS_OK(close((40 * (i + 1)) + j));
-                        } 
-                    }              
-                }
-            }
-
-            for (int i = 0; i < n; i++) {
-                int me = i + 1;
-                if (i != k) {
-                    if (i != 0) {
-                        ASSERT_SYS_OK(close(700 + 6 * me + 0));
-                        ASSERT_SYS_OK(close(700 + 6 * me + 0 - 3));
-                    }
-
-                    if (2 * me <= n) {
-                        ASSERT_SYS_OK(close(700 + 6 * me + 1));
-                        ASSERT_SYS_OK(close(700 + 6 * me + 1 - 3));
-                    }
-
-                    if (2 * me + 1 <= n) {
-                        ASSERT_SYS_OK(close(700 + 6 * me + 2));
-                        ASSERT_SYS_OK(close(700 + 6 * me + 2 - 3));
-                    }   
-                }
-            }
+            ASSERT_SYS_OK(sprintf(table, FD_TABLE_VAR "=%d,%d",
+                FD_TABLE_BASE, table_sizes[k]));
+            ASSERT_ZERO(putenv(table));
 
-            if (k == 0) {
-                for (int i = 2; i <= n; i++) {
-                    ASSERT_SYS_OK(close(900 + 4 * i + 2));
-                    ASSERT_SYS_OK(close(900 + 4 * i + 3));
-                }
-            }
-            else {
-                for (int i = 2; i <= n; i++) {
-                    if (i != k + 1) {
-                        for (int j = 0; j < 4; j++)
-                            ASSERT_SYS_OK(close(900 + 4 * i + j));
-                    }
-                    else {
-                        ASSERT_SYS_OK(close(900 + 4 * i + 1));
-                        ASSERT_SYS_OK(close(900 + 4 * i + 0));
-                    }
-                }
+            // Only mimpirun may hold these, or no rank would see the end.
+            for (int j = 0; j <= k; j++) {
+                ASSERT_SYS_OK(close(controls[j]));
             }
+            receiveDescriptors(k, control, table_sizes[k]);
 
             ASSERT_SYS_OK(execvp(path, args));
         }
         else if (status < 0) {
             exit(-1);
         }
+        ASSERT_SYS_OK(close(control));
     }
 
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < 2; j++) {
-            int me = i + 1;
-            int id = j + 1;
-            if (2 * me + j <= n) {
-                ASSERT_SYS_OK(close(700 + 6 * me - 3 + id));
-                ASSERT_SYS_OK(close(700 + 6 * (2 * me + (id - 1))));
-                ASSERT_SYS_OK(close(700 + 6 * (2 * me + j) - 3));
-                ASSERT_SYS_OK(close(700 + 6 * me + id));
-            }
-        }
-    }
-
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            if (i != j) {
-                ASSERT_SYS_OK(close((20 * (2 * i + 1)) + j));
-                ASSERT_SYS_OK(close((40 * (i + 1)) + j));
-            }                
-        }
-    }
-
-    for (int i = 2; i <= n; i++) {
-        for (int j = 0; j < 4; j++) {
-            ASSERT_SYS_OK(close(900 + 4 * i + j));
-        }
+    createChannels(n);
+    for (int k = 0; k < n; k++) {
+        ASSERT_SYS_OK(close(controls[k]));
+        fdTableFree(&slots[k]);
     }
+    free(slots);
+    free(controls);
+    free(table_sizes);
 
+    // A rank that failed (an assertion, a fatal error, a signal) fails the run.
+    bool failed = false;
     char* temp = (char*) malloc(strlen("MIMPI_") + 20 + 1);
     for (int i = 0; i < n; i++) {
-        pid_t child = wait(NULL);
+        int child_status;
+        pid_t child = wait(&child_status);
         if (child > 0) {
+            if (!WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0) {
+                failed = true;
+            }
             ASSERT_SYS_OK(sprintf(temp, "MIMPI_%d", child));
             ASSERT_ZERO(unsetenv(temp));
         }
@@ -195,8 +487,9 @@ int main(int argc, char **argv) {
 
     ASSERT_ZERO(unsetenv("MIMPI_n"));
     free(pid);
+    free(table);
     free(name);
     free(temp);
 
-    return 0;
-}
\ No newline at end of file
+    return failed ? 1 : 0;
+}
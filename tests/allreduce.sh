@@ -0,0 +1,7 @@
+set -ex
+timeout 10s ./mimpirun 1 examples_build/allreduce
+timeout 10s ./mimpirun 2 examples_build/allreduce
+timeout 10s ./mimpirun 5 examples_build/allreduce
+timeout 10s ./mimpirun 8 examples_build/allreduce
+MIMPI_ALLREDUCE_RING=0 timeout 10s ./mimpirun 7 examples_build/allreduce
+MIMPI_ALLREDUCE_RING=1000000000 timeout 10s ./mimpirun 7 examples_build/allreduce
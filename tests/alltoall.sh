@@ -0,0 +1,5 @@
+set -ex
+timeout 10s ./mimpirun 1 examples_build/alltoall
+timeout 10s ./mimpirun 2 examples_build/alltoall
+timeout 10s ./mimpirun 5 examples_build/alltoall
+timeout 10s ./mimpirun 8 examples_build/alltoall
@@ -0,0 +1,11 @@
+set -ex
+for algorithm in tree dissemination; do
+    export MIMPI_BARRIER=$algorithm
+    timeout 1s ./mimpirun 1 examples_build/barrier
+    timeout 1s ./mimpirun 5 examples_build/barrier
+    timeout 1s ./mimpirun 16 examples_build/barrier
+    timeout 5s ./mimpirun 64 examples_build/many_ranks
+    timeout 1s ./mimpirun 2 examples_build/barrier_finished
+    timeout 1s ./mimpirun 5 examples_build/barrier_finished
+    timeout 1s ./mimpirun 8 examples_build/barrier_finished
+done
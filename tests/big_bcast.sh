@@ -0,0 +1,4 @@
+set -ex
+timeout 5s ./mimpirun 6 examples_build/big_bcast
+MIMPI_BCAST_SEGMENT=777 timeout 5s ./mimpirun 6 examples_build/big_bcast
+MIMPI_BCAST_SEGMENT=100000000 timeout 5s ./mimpirun 3 examples_build/big_bcast
@@ -0,0 +1,3 @@
+set -ex
+timeout 10s ./mimpirun 2 examples_build/comm_recycle
+timeout 20s ./mimpirun 5 examples_build/comm_recycle
@@ -0,0 +1,7 @@
+set -ex
+timeout 10s ./mimpirun 1 examples_build/communicators
+timeout 10s ./mimpirun 2 examples_build/communicators
+timeout 10s ./mimpirun 5 examples_build/communicators
+timeout 10s ./mimpirun 8 examples_build/communicators
+MIMPI_BARRIER=dissemination MIMPI_BCAST=binomial MIMPI_ALLREDUCE=ring timeout 10s ./mimpirun 7 examples_build/communicators
+MIMPI_EAGER_THRESHOLD=0 timeout 10s ./mimpirun 6 examples_build/communicators
@@ -0,0 +1,6 @@
+set -ex
+timeout 2s ./mimpirun 2 examples_build/deadlock_cycle
+timeout 2s ./mimpirun 3 examples_build/deadlock_cycle
+timeout 2s ./mimpirun 8 examples_build/deadlock_cycle
+MIMPI_TRANSPORT=shm timeout 2s ./mimpirun 5 examples_build/deadlock_cycle
+MIMPI_DEADLOCK_DELAY=0 timeout 2s ./mimpirun 5 examples_build/deadlock_cycle
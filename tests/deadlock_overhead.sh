@@ -0,0 +1,3 @@
+set -ex
+timeout 20s ./mimpirun 4 examples_build/deadlock_overhead 0 2000
+timeout 20s ./mimpirun 4 examples_build/deadlock_overhead 1 2000
@@ -0,0 +1,5 @@
+set -ex
+timeout 5s ./mimpirun 2 examples_build/detached_limit
+MIMPI_DETACHED_LIMIT=1048576 timeout 5s ./mimpirun 2 examples_build/detached_limit
+MIMPI_DETACHED_LIMIT=0 timeout 5s ./mimpirun 3 examples_build/detached_limit
+MIMPI_DETACHED_LIMIT=0 timeout 5s ./mimpirun 5 examples_build/rendezvous
@@ -0,0 +1,6 @@
+set -ex
+timeout 5s ./mimpirun 2 examples_build/finalize_sends
+timeout 5s ./mimpirun 2 examples_build/finalize_sends
+timeout 5s ./mimpirun 5 examples_build/finalize_sends
+MIMPI_TRANSPORT=shm timeout 5s ./mimpirun 3 examples_build/finalize_sends
+timeout 5s ./mimpirun 1 examples_build/finalize_sends
@@ -0,0 +1,5 @@
+set -ex
+timeout 2s ./mimpirun 2 examples_build/flow_control
+MIMPI_PEER_BUDGET=65536 timeout 2s ./mimpirun 2 examples_build/flow_control
+MIMPI_RANK_BUDGET=100000 timeout 2s ./mimpirun 3 examples_build/flow_control
+MIMPI_PEER_BUDGET=0 timeout 2s ./mimpirun 3 examples_build/writers_reader
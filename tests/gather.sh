@@ -0,0 +1,6 @@
+set -ex
+timeout 10s ./mimpirun 1 examples_build/gather
+timeout 10s ./mimpirun 2 examples_build/gather
+timeout 10s ./mimpirun 6 examples_build/gather
+timeout 10s ./mimpirun 8 examples_build/gather
+MIMPI_ALLGATHER_RING=0 timeout 10s ./mimpirun 8 examples_build/gather
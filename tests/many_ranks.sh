@@ -0,0 +1,7 @@
+set -ex
+timeout 5s ./mimpirun 64 examples_build/many_ranks
+timeout 5s ./mimpirun 1 examples_build/many_ranks
+timeout 30s ./mimpirun 256 examples_build/many_ranks
+MIMPI_TRANSPORT=shm timeout 30s ./mimpirun 256 examples_build/many_ranks
+ulimit -n 1024
+timeout 30s ./mimpirun 256 examples_build/many_ranks
@@ -0,0 +1,5 @@
+set -ex
+timeout 1s ./mimpirun 2 examples_build/nonblocking
+timeout 1s ./mimpirun 7 examples_build/nonblocking
+MIMPI_PEER_BUDGET=0 MIMPI_DETACHED_LIMIT=0 timeout 1s ./mimpirun 2 examples_build/nonblocking
+MIMPI_PEER_BUDGET=0 MIMPI_DETACHED_LIMIT=0 timeout 1s ./mimpirun 7 examples_build/nonblocking
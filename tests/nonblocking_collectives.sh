@@ -0,0 +1,6 @@
+set -ex
+timeout 10s ./mimpirun 1 examples_build/nonblocking_collectives
+timeout 10s ./mimpirun 2 examples_build/nonblocking_collectives
+timeout 10s ./mimpirun 7 examples_build/nonblocking_collectives
+MIMPI_BARRIER=dissemination MIMPI_BCAST=binomial timeout 10s ./mimpirun 9 examples_build/nonblocking_collectives
+MIMPI_EAGER_THRESHOLD=0 timeout 10s ./mimpirun 5 examples_build/nonblocking_collectives
@@ -0,0 +1,5 @@
+set -ex
+timeout 5s ./mimpirun 2 examples_build/pool
+timeout 5s ./mimpirun 4 examples_build/pool
+MIMPI_TRANSPORT=shm timeout 5s ./mimpirun 2 examples_build/pool
+MIMPI_POOL_REPORT=1 timeout 5s ./mimpirun 2 examples_build/pool 2>&1 | grep -q "rank 0: pool sweep releases [1-9]"
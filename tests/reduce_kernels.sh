@@ -0,0 +1,2 @@
+set -ex
+timeout 10s examples_build/reduce_kernels 100003
@@ -0,0 +1,5 @@
+set -ex
+timeout 2s ./mimpirun 2 examples_build/rendezvous
+timeout 2s ./mimpirun 5 examples_build/rendezvous
+MIMPI_EAGER_THRESHOLD=0 timeout 2s ./mimpirun 3 examples_build/nonblocking
+MIMPI_TRANSPORT=shm timeout 2s ./mimpirun 3 examples_build/rendezvous
@@ -0,0 +1,6 @@
+set -ex
+export MIMPI_TRANSPORT=shm
+timeout 0.4 ./mimpirun 2 examples_build/big_message
+timeout 1s ./mimpirun 7 examples_build/nonblocking
+MIMPI_SHM_RING_SIZE=4096 timeout 1s ./mimpirun 2 examples_build/nonblocking
+timeout 5s ./mimpirun 16 examples_build/many_ranks
@@ -0,0 +1,15 @@
+set -ex
+dir=$(mktemp -d)
+trap 'rm -rf $dir' EXIT
+MIMPI_TRACE=$dir/run timeout 5s ./mimpirun 4 examples_build/trace
+timeout 5s ./mimpirun --trace-json $dir/trace.json $dir/run.*
+grep -q '"name":"rank 3 of 4"' $dir/trace.json
+grep -q '"name":"progress engine"' $dir/trace.json
+grep -q '"name":"MIMPI_Recv","cat":"mimpi","ph":"B"' $dir/trace.json
+grep -q '"name":"MIMPI_Barrier","ph":"E"' $dir/trace.json
+grep -q '"name":"arrival"' $dir/trace.json
+grep -q '"name":"payload"' $dir/trace.json
+MIMPI_TRACE=$dir/small MIMPI_TRACE_EVENTS=4 timeout 5s ./mimpirun 3 examples_build/trace
+timeout 5s ./mimpirun --trace-json $dir/small.json $dir/small.* 2>&1 | grep -q "dropped"
+timeout 5s ./mimpirun 2 examples_build/trace
+! timeout 5s ./mimpirun --trace-json $dir/bad.json $dir/trace.json
@@ -0,0 +1,31 @@
+set -ex
+table=$(mktemp)
+trap 'rm -f $table' EXIT
+
+timeout 20s ./mimpirun --autotune $table 4
+grep -q '^barrier 4 \* ' $table
+export MIMPI_TUNING_FILE=$table
+timeout 5s ./mimpirun 4 examples_build/big_bcast
+timeout 5s ./mimpirun 4 examples_build/big_reduce
+timeout 10s ./mimpirun 4 examples_build/allreduce
+timeout 10s ./mimpirun 4 examples_build/gather
+
+cat > $table <<END
+# Every other algorithm, whatever the defaults.
+barrier 8 * dissemination
+bcast * 1000 binomial
+reduce * * binomial
+allreduce 3 * ring
+allreduce * 100 ring
+allgather * * ring
+END
+timeout 1s ./mimpirun 8 examples_build/barrier_finished
+timeout 5s ./mimpirun 6 examples_build/big_bcast
+timeout 5s ./mimpirun 6 examples_build/big_reduce
+timeout 10s ./mimpirun 3 examples_build/allreduce
+timeout 10s ./mimpirun 8 examples_build/allreduce
+timeout 10s ./mimpirun 8 examples_build/gather
+MIMPI_REDUCE=binary timeout 10s ./mimpirun 5 examples_build/typed_reduce
+
+echo "bcast * * quadtree" > $table
+timeout 1s ./mimpirun 2 examples_build/barrier 2>&1 | grep -q "unknown algorithm"
@@ -0,0 +1,3 @@
+set -ex
+timeout 10s ./mimpirun 5 examples_build/typed_reduce
+MIMPI_REDUCE_SEGMENT=1001 timeout 10s ./mimpirun 4 examples_build/typed_reduce